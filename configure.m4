@@ -13,10 +13,19 @@ divert(-1)
 # - zproject.lst (TARGET=5): List of source files to compile
 #
 # The following definitions are also configurable from the M4 command-line:
+# - USE_TYPE_AHEAD
+# - USE_ADAPTIVE_TURBO
 # - USE_TIMEX_HIRES
+# - USE_DMA_SCROLL
+# - USE_TILEMAP_TEXT
 # - USE_GFX
+# - USE_LINE_GFX
+# - USE_IMAGE_CACHE
 # - USE_MOUSE
 # - USE_CODEFOLLOW
+# - USE_UNDO
+# - USE_PROFILER
+# - USE_PAGE_DUMP
 # - USE_IMAGE_SLIDESHOW
 ################################################################################
 
@@ -42,11 +51,32 @@ define(`ASCII_CODE_UP', 253)
 # ASCII code associated with CAPS SHIFT + 6 (down arrow key).
 define(`ASCII_CODE_DOWN', 254)
 
+# Non-zero to scan the keyboard in an IM2 ISR and queue the typed keys so that
+# keys typed while the interpreter is busy are not lost, default is off.
+ifdef(`USE_TYPE_AHEAD',, `define(`USE_TYPE_AHEAD', 0)')
+
+# Non-zero to slow down the CPU to 3.5 MHz when waiting for a key at the input
+# prompt for a while and speed it up to 28 MHz again when a key is typed, default
+# is off. Requires USE_TYPE_AHEAD.
+ifdef(`USE_ADAPTIVE_TURBO',, `define(`USE_ADAPTIVE_TURBO', 0)')
+ifelse(USE_TYPE_AHEAD, 0, `define(`USE_ADAPTIVE_TURBO', 0)')
+
 # Text output
 
 # Non-zero to enable Timex hi-res mode for text, default is ULA mode.
 ifdef(`USE_TIMEX_HIRES',, `define(`USE_TIMEX_HIRES', 0)')
 
+# Non-zero to scroll the text window using the zxnDMA instead of the CPU,
+# default is off.
+ifdef(`USE_DMA_SCROLL',, `define(`USE_DMA_SCROLL', 0)')
+
+# Non-zero to display the text window on the 80 x 32 hardware tilemap using a
+# fixed-width version of the QLStyle font instead of on the ULA screen using
+# the FZX proportional font, default is off. Overrides USE_TIMEX_HIRES and
+# USE_DMA_SCROLL.
+ifdef(`USE_TILEMAP_TEXT',, `define(`USE_TILEMAP_TEXT', 0)')
+ifelse(USE_TILEMAP_TEXT, 0,, `define(`USE_TIMEX_HIRES', 0)define(`USE_DMA_SCROLL', 0)')
+
 # Height of text window in characters.
 define(`TEXT_WINDOW_HEIGHT', 24)
 
@@ -61,6 +91,17 @@ define(`TEXT_FONT_COLOR_INDEX', 1)
 # Non-zero to enable title and location graphics, default is no graphics.
 ifdef(`USE_GFX',, `define(`USE_GFX', 0)')
 
+# Non-zero to draw the line-drawn location images of the V2/V3 games at runtime
+# from the picture data file gfx/gfx.dat created by the convert_gfx tool instead
+# of loading pre-converted NXI images, default is off. Requires USE_GFX.
+ifdef(`USE_LINE_GFX',, `define(`USE_LINE_GFX', 0)')
+
+# Non-zero to load as much of the image archive as fits into the spare RAM on a
+# Spectrum Next with 2 MB RAM at startup and load the images from RAM, default
+# is off. Requires USE_GFX.
+ifdef(`USE_IMAGE_CACHE',, `define(`USE_IMAGE_CACHE', 0)')
+ifelse(USE_GFX, 0, `define(`USE_IMAGE_CACHE', 0)')
+
 # Mouse
 
 # Non-zero to enable mouse support, default is no mouse support.
@@ -71,6 +112,19 @@ ifdef(`USE_MOUSE',, `define(`USE_MOUSE', 0)')
 # Non-zero to log interpreter code execution to a file, default is off.
 ifdef(`USE_CODEFOLLOW',, `define(`USE_CODEFOLLOW', 0)')
 
+# Non-zero to enable the #undo command, which restores the game state as it was
+# before one or more of the previous commands, default is off.
+ifdef(`USE_UNDO',, `define(`USE_UNDO', 0)')
+
+# Non-zero to measure the time spent in the interpreter and the OS layer and
+# enable the #profile command, which prints the measured times, default is off.
+# Used for debugging and performance tuning.
+ifdef(`USE_PROFILER',, `define(`USE_PROFILER', 0)')
+
+# Non-zero to enable the #pages command, which prints the owners of the spare
+# MMU pages, default is off. Used for debugging.
+ifdef(`USE_PAGE_DUMP',, `define(`USE_PAGE_DUMP', 0)')
+
 # Image slideshow
 
 # Non-zero to enable image slideshow, default is off.
@@ -91,12 +145,17 @@ divert
 `#define' `ASCII_CODE_INV_VIDEO' ASCII_CODE_INV_VIDEO
 `#define' `ASCII_CODE_UP' ASCII_CODE_UP
 `#define' `ASCII_CODE_DOWN' ASCII_CODE_DOWN
+`#define' `USE_TYPE_AHEAD' USE_TYPE_AHEAD
+`#define' `USE_ADAPTIVE_TURBO' USE_ADAPTIVE_TURBO
 
 `#define' `USE_TIMEX_HIRES' USE_TIMEX_HIRES
+`#define' `USE_TILEMAP_TEXT' USE_TILEMAP_TEXT
 `#define' `TEXT_WINDOW_HEIGHT' TEXT_WINDOW_HEIGHT
 `#define' `TEXT_FONT_COLOR_INDEX' TEXT_FONT_COLOR_INDEX
 
 `#define' `USE_GFX' USE_GFX
+`#define' `USE_LINE_GFX' USE_LINE_GFX
+`#define' `USE_IMAGE_CACHE' USE_IMAGE_CACHE
 
 `#define' `USE_MOUSE' USE_MOUSE
 
@@ -105,6 +164,12 @@ ifelse(USE_CODEFOLLOW, 0,,
 `#define' `CODEFOLLOW'
 ')dnl
 
+`#define' `USE_UNDO' USE_UNDO
+
+`#define' `USE_PROFILER' USE_PROFILER
+
+`#define' `USE_PAGE_DUMP' USE_PAGE_DUMP
+
 `#define' `USE_IMAGE_SLIDESHOW' USE_IMAGE_SLIDESHOW
 
 `#endif'
@@ -126,8 +191,11 @@ defc `ASCII_CODE_TRUE_VIDEO' = ASCII_CODE_TRUE_VIDEO
 defc `ASCII_CODE_INV_VIDEO' = ASCII_CODE_INV_VIDEO
 defc `ASCII_CODE_UP' = ASCII_CODE_UP
 defc `ASCII_CODE_DOWN' = ASCII_CODE_DOWN
+defc `USE_TYPE_AHEAD' = USE_TYPE_AHEAD
 
 defc `USE_TIMEX_HIRES' = USE_TIMEX_HIRES
+defc `USE_DMA_SCROLL' = USE_DMA_SCROLL
+defc `USE_TILEMAP_TEXT' = USE_TILEMAP_TEXT
 defc `TEXT_WINDOW_HEIGHT' = TEXT_WINDOW_HEIGHT
 
 defc `USE_GFX' = USE_GFX
@@ -149,6 +217,8 @@ divert
 
 `define'(`USE_TIMEX_HIRES', USE_TIMEX_HIRES)
 
+`define'(`USE_TILEMAP_TEXT', USE_TILEMAP_TEXT)
+
 `define'(`TEXT_WINDOW_HEIGHT', TEXT_WINDOW_HEIGHT)
 
 `define'(`TEXT_FONT', TEXT_FONT)
@@ -185,7 +255,13 @@ ifelse(USE_TIMEX_HIRES, 0,
 `#pragma' output CLIB_EXIT_STACK_SIZE = 1
 
 // Reduce the size of printf to what is needed.
+ifelse(USE_PROFILER, 0,
+`
 `#pragma' printf = "%s %u %X"
+',
+`
+`#pragma' printf = "%s %u %X %lu"
+')dnl
 
 // Include crt_driver_instantiation.asm.m4 in driver instantiation section.
 `#pragma' output CRT_INCLUDE_DRIVER_INSTANTIATION = 1
@@ -201,13 +277,25 @@ ifelse(TARGET, 5,
 divert
 src/level9.c
 src/memory_paging.asm
+src/page_allocator.c
 src/main.c
 src/sprite.c
 src/interrupt.asm
+src/interrupt_dispatcher.c
 src/in_key_translation_table.asm
 src/zx_01_input_kbd_inkey_custom.asm
+ifelse(USE_TYPE_AHEAD, 0,,
+`
+src/key_queue.c
+')dnl
+ifelse(USE_ADAPTIVE_TURBO, 0,,
+`
+src/turbo.c
+')dnl
 src/scroll_prompt.asm
 src/text_color.asm
+ifelse(USE_TILEMAP_TEXT, 0,
+`
 ifelse(TEXT_FONT, `_ff_pd_QLStyle',
 `
 src/_ff_pd_QLStyle.asm
@@ -219,17 +307,42 @@ src/zx_01_output_fzx_custom.asm
 `
 src/tshr_01_output_fzx_custom.asm
 ')dnl
+ifelse(USE_DMA_SCROLL, 0,,
+`
+src/text_scroll.asm
+')dnl
+',
+`
+src/tilemap_text.asm
+src/tile_01_output_char_custom.asm
+')dnl
 ifelse(USE_GFX, 0,,
 `
 src/layer2.c
 src/image_scroll.asm
 ')dnl
+ifelse(USE_IMAGE_CACHE, 0,,
+`
+src/image_cache.c
+')dnl
+ifelse(eval(USE_GFX && USE_LINE_GFX), 0,,
+`
+src/line_gfx.c
+')dnl
 ifelse(USE_MOUSE, 0,,
 `
 src/asm_in_mouse_kempston.asm
 src/asm_in_mouse_kempston_wheel.asm
 src/mouse.c
 ')dnl
+ifelse(eval(USE_PROFILER || USE_IMAGE_SLIDESHOW), 0,,
+`
+src/raster_time.c
+')dnl
+ifelse(USE_PROFILER, 0,,
+`
+src/profiler.c
+')dnl
 ifelse(USE_IMAGE_SLIDESHOW, 0,,
 `
 src/image_slideshow.c
@@ -10,16 +10,23 @@
    ;# graphics above it. The cursor position of the stdout terminal is set to
    ;# the bottom row to avoid the cursor from ever being located behind the
    ;# graphics.
+   ;#
+   ;# If USE_TILEMAP_TEXT is enabled, the stdout terminal is instead a character
+   ;# terminal that uses the 80 x 32 hardware tilemap. Its window is placed at
+   ;# the same vertical position as the ULA screen.
 
 divert(-1)
    include(`zconfig.m4')
 
-   ifelse(USE_TIMEX_HIRES, 0, `define(`SCREEN_MODE', 0)', `define(`SCREEN_MODE', 1)')
+   ifelse(USE_TILEMAP_TEXT, 0,
+      `ifelse(USE_TIMEX_HIRES, 0, `define(`SCREEN_MODE', 0)', `define(`SCREEN_MODE', 1)')',
+      `define(`SCREEN_MODE', 2)')
    define(`WINDOW_HEIGHT', TEXT_WINDOW_HEIGHT)
    define(`WINDOW_Y', eval(24 - WINDOW_HEIGHT))
    define(`PAPER_HEIGHT', eval(WINDOW_HEIGHT * 8))
    define(`PAPER_Y', eval(192 - PAPER_HEIGHT))
    define(`CURSOR_Y', eval(PAPER_HEIGHT - 8))
+   define(`TILEMAP_WINDOW_Y', eval(4 + WINDOW_Y))
 divert
 
    EXTERN TEXT_FONT
@@ -42,6 +49,13 @@ ifelse(SCREEN_MODE, 1,
    m4_tshr_01_output_fzx_custom(_stdout, 0x2070, 0, CURSOR_Y, 0, 64, WINDOW_Y, WINDOW_HEIGHT, WINDOW_HEIGHT, TEXT_FONT, 0, 512, PAPER_Y, PAPER_HEIGHT, M4__CRT_OTERM_FZX_DRAW_MODE, CRT_OTERM_FZX_LINE_SPACING, CRT_OTERM_FZX_LEFT_MARGIN, CRT_OTERM_FZX_SPACE_EXPAND)dnl
 ')dnl
 
+ifelse(SCREEN_MODE, 2,
+`
+   ;# Tilemap stdout terminal (fd=1)
+   include(`src/tile_01_output_char_custom.m4')dnl
+   m4_tile_01_output_char_custom(_stdout, 0x2070, 0, eval(WINDOW_HEIGHT - 1), 0, 80, TILEMAP_WINDOW_Y, WINDOW_HEIGHT, WINDOW_HEIGHT)dnl
+')dnl
+
    ;# Output terminal for stderr (fd=2), duplicate of stdout terminal
    include(`../m4_file_dup.m4')dnl
    m4_file_dup(_stderr, 0x80, __i_fcntl_fdstruct_1)dnl
@@ -0,0 +1,189 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of image_cache.h.
+ *
+ * The cached part of the archive is loaded via MMU slot 2 and read via MMU slot
+ * 0, where the ROM is normally paged in when loading images. The current file
+ * position of the cached archive is tracked here and only synced with ESXDOS
+ * when reading from the uncached part.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <arch/zxn/esxdos.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "image_cache.h"
+#include "page_allocator.h"
+#include "ide_friendly.h"
+
+#define MMU0_ADDRESS ((uint8_t *) 0x0000)
+#define MMU2_ADDRESS ((uint8_t *) 0x4000)
+
+static uint8_t cached_filehandle = ESX_INVALID_FILE_HANDLE;
+
+static uint8_t cache_first_page = 0;
+
+static uint32_t cached_size = 0;
+
+static uint32_t cache_pos;
+
+bool image_cache_fill(uint8_t archive) __z88dk_fastcall
+{
+    struct esx_stat filestat;
+    uint32_t num_archive_pages;
+    uint8_t num_cache_pages;
+    uint8_t num_used_pages = 0;
+    uint16_t num_read;
+
+    image_cache_clear();
+
+    if (get_num_pages() != NUM_PAGES_2MB)
+    {
+        return false;
+    }
+
+    errno = 0;
+    esx_f_fstat(archive, &filestat);
+    if (errno || (filestat.size == 0))
+    {
+        errno = 0;
+        return false;
+    }
+
+    // Only allocate the pages needed for the archive so that there are no
+    // unused pages to give back afterwards.
+    num_cache_pages = get_max_free_pages();
+    if (num_cache_pages <= IMAGE_CACHE_SPARE_PAGES)
+    {
+        return false;
+    }
+    num_cache_pages -= IMAGE_CACHE_SPARE_PAGES;
+    num_archive_pages = (filestat.size + 0x1FFF) >> 13;
+    if (num_archive_pages < num_cache_pages)
+    {
+        num_cache_pages = (uint8_t) num_archive_pages;
+    }
+    cache_first_page = alloc_pages(num_cache_pages, "Image cache");
+    if (cache_first_page == 0)
+    {
+        return false;
+    }
+
+    esx_f_seek(archive, 0, ESX_SEEK_SET);
+
+    fputs("Loading images", stdout);
+
+    while (!errno && (num_used_pages < num_cache_pages))
+    {
+        ZXN_WRITE_MMU2(cache_first_page + num_used_pages);
+        num_read = esx_f_read(archive, MMU2_ADDRESS, 0x2000);
+        ZXN_WRITE_MMU2(10);
+
+        if (errno || (num_read == 0))
+        {
+            break;
+        }
+
+        cached_size += num_read;
+        num_used_pages++;
+
+        // Print a dot for each 64 KB loaded.
+        if ((num_used_pages & 0x07) == 0)
+        {
+            putchar('.');
+        }
+
+        if (num_read < 0x2000)
+        {
+            break;
+        }
+    }
+
+    putchar('\n');
+
+    if (num_used_pages != 0)
+    {
+        cached_filehandle = archive;
+    }
+    else
+    {
+        free_pages(cache_first_page);
+        cached_size = 0;
+    }
+
+    errno = 0;
+    return num_used_pages != 0;
+}
+
+void image_cache_clear(void)
+{
+    if (cached_filehandle != ESX_INVALID_FILE_HANDLE)
+    {
+        free_pages(cache_first_page);
+        cached_filehandle = ESX_INVALID_FILE_HANDLE;
+        cached_size = 0;
+    }
+}
+
+uint16_t image_cache_read(uint8_t filehandle, void *dst, uint16_t len)
+{
+    uint8_t saved_mmu0;
+    uint8_t *dst_ptr = (uint8_t *) dst;
+    uint16_t offset;
+    uint16_t num_bytes;
+
+    if (filehandle != cached_filehandle)
+    {
+        return esx_f_read(filehandle, dst, len);
+    }
+
+    if (cache_pos + len > cached_size)
+    {
+        // Read the uncached part of the archive from file.
+        esx_f_seek(filehandle, cache_pos, ESX_SEEK_SET);
+        if (errno)
+        {
+            return 0;
+        }
+        num_bytes = esx_f_read(filehandle, dst, len);
+        cache_pos += num_bytes;
+        return num_bytes;
+    }
+
+    saved_mmu0 = ZXN_READ_REG(REG_MMU0);
+
+    for (uint16_t rest = len; rest != 0; rest -= num_bytes)
+    {
+        offset = (uint16_t) cache_pos & 0x1FFF;
+        num_bytes = 0x2000 - offset;
+        if (num_bytes > rest)
+        {
+            num_bytes = rest;
+        }
+
+        ZXN_WRITE_MMU0(cache_first_page + (uint8_t) (cache_pos >> 13));
+        memcpy(dst_ptr, MMU0_ADDRESS + offset, num_bytes);
+        dst_ptr += num_bytes;
+        cache_pos += num_bytes;
+    }
+
+    ZXN_WRITE_MMU0(saved_mmu0);
+    return len;
+}
+
+void image_cache_seek(uint8_t filehandle, uint32_t offset)
+{
+    if (filehandle != cached_filehandle)
+    {
+        esx_f_seek(filehandle, offset, ESX_SEEK_SET);
+        return;
+    }
+
+    // The file is synced when reading from its uncached part.
+    cache_pos = offset;
+}
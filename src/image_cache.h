@@ -0,0 +1,49 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Cache for the image archive file in the spare RAM of a Spectrum Next with
+ * 2 MB RAM. Only compiled if USE_IMAGE_CACHE = 1.
+ *
+ * When the image archive file of a game is opened, as much of it as fits in
+ * the largest free block of spare MMU pages is loaded into RAM. The images in
+ * the cached part of the archive are then loaded from RAM instead of from the
+ * SD card. The image loader reads and seeks the image files via the functions
+ * below, which fall back to ESXDOS for other files and for the uncached part of
+ * the cached archive.
+ ******************************************************************************/
+
+#ifndef _IMAGE_CACHE_H
+#define _IMAGE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ide_friendly.h"
+
+// Number of spare MMU pages left for other users when filling the cache.
+#define IMAGE_CACHE_SPARE_PAGES 8
+
+/*
+ * Load as much of the given image archive file as fits in the spare RAM, if
+ * the Spectrum Next has 2 MB RAM, and print a progress indicator while doing
+ * so. Any previously cached archive is dropped. Returns true if any part of the
+ * archive is cached. It is assumed that the ROM is paged in.
+ */
+bool image_cache_fill(uint8_t archive) __z88dk_fastcall;
+
+/*
+ * Drop the cached archive and free its MMU pages.
+ */
+void image_cache_clear(void);
+
+/*
+ * Read the given number of bytes from the given file, from RAM if possible.
+ * Returns the number of bytes read and sets errno like esx_f_read().
+ */
+uint16_t image_cache_read(uint8_t filehandle, void *dst, uint16_t len);
+
+/*
+ * Seek to the given position in the given file. Sets errno like esx_f_seek().
+ */
+void image_cache_seek(uint8_t filehandle, uint32_t offset);
+
+#endif
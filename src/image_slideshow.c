@@ -6,17 +6,30 @@
  * choice games, press the A key to switch to the previous game part and the S
  * key to switch to the next game part. Press any other key to exit the
  * slideshow.
+ *
+ * Press the B key to run the image benchmark, which loads and displays all
+ * existing location images (of all game parts) one after another, first from
+ * the separate NXI image files and then from the image archive file if
+ * available. Each phase of loading and displaying an image is timed and the
+ * minimum, average and maximum time of each phase is printed when done.
+ *
+ * The time is measured in raster lines (64 us each) with the raster line timer
+ * in raster_time.h.
  ******************************************************************************/
 
+#include <arch/zxn.h>
+#include <arch/zxn/esxdos.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <input.h>
 #include <errno.h>
 
 #include "zconfig.h"
 #include "image_slideshow.h"
 #include "layer2.h"
+#include "raster_time.h"
 #include "ide_friendly.h"
 
 #define MIN_IMAGE 1
@@ -25,6 +38,22 @@
 #define MIN_GAME_PART 1
 #define MAX_GAME_PART 4
 
+typedef struct phase_stats
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+} phase_stats_t;
+
+static const char *phase_names[BENCHMARK_NUM_PHASES + 1] =
+{
+    "Open   ",
+    "Palette",
+    "Pixels ",
+    "Flip   ",
+    "Total  "
+};
+
 extern uint8_t tmp_buffer[256];
 
 extern bool multiple_choice_game;
@@ -35,7 +64,26 @@ static uint16_t image = 0;
 
 static uint8_t game_part = MIN_GAME_PART;
 
-static uint8_t filename[16];
+static uint8_t filename[20];
+
+static bool benchmark_running = false;
+
+static uint32_t last_mark_time;
+
+// Time of each phase of the image being loaded and displayed.
+static uint32_t phase_time[BENCHMARK_NUM_PHASES];
+
+static phase_stats_t stats[BENCHMARK_NUM_PHASES + 1];
+
+static uint16_t num_images;
+
+static void flip_image(void)
+{
+    wait_video_line(max_image_height);
+    layer2_flip_main_shadow_screen();
+    layer2_flip_display_palettes();
+    benchmark_mark(BENCHMARK_PHASE_FLIP);
+}
 
 static bool show_image(uint16_t image_number) __z88dk_fastcall
 {
@@ -52,9 +100,7 @@ static bool show_image(uint16_t image_number) __z88dk_fastcall
     layer2_load_screen(SHADOW_SCREEN, layer2_get_unused_access_palette(), filename, tmp_buffer);
     if (!errno)
     {
-        wait_video_line(max_image_height);
-        layer2_flip_main_shadow_screen();
-        layer2_flip_display_palettes();
+        flip_image();
     }
 
     return !errno;
@@ -108,6 +154,169 @@ static void toggle_game_part(bool next) __z88dk_fastcall
     toggle_image(true);
 }
 
+/*******************************************************************************
+ * Image Benchmark
+ ******************************************************************************/
+
+void benchmark_mark(uint8_t phase) __z88dk_fastcall
+{
+    uint32_t time;
+
+    if (benchmark_running)
+    {
+        time = get_raster_time();
+        phase_time[phase] = time - last_mark_time;
+        last_mark_time = time;
+    }
+}
+
+static void add_sample(phase_stats_t *phase_stats, uint32_t time)
+{
+    if ((num_images == 0) || (time < phase_stats->min))
+    {
+        phase_stats->min = time;
+    }
+    if (time > phase_stats->max)
+    {
+        phase_stats->max = time;
+    }
+    phase_stats->total += time;
+}
+
+static void add_image_samples(void)
+{
+    uint32_t total = 0;
+
+    for (uint8_t i = 0; i < BENCHMARK_NUM_PHASES; i++)
+    {
+        add_sample(&stats[i], phase_time[i]);
+        total += phase_time[i];
+    }
+
+    add_sample(&stats[BENCHMARK_NUM_PHASES], total);
+    num_images++;
+}
+
+static void print_time(uint32_t lines) __z88dk_fastcall
+{
+    // One raster line is 64 us, print the time in ms with one decimal.
+    uint16_t time = (uint16_t) ((lines * 64) / 100);
+    printf(" %u.%u", time / 10, time % 10);
+}
+
+static void print_stats(const char *source) __z88dk_fastcall
+{
+    printf("Image benchmark (%s): %u images\n", source, num_images);
+    if (num_images == 0)
+    {
+        return;
+    }
+
+    printf("Phase    min/avg/max (ms)\n");
+    for (uint8_t i = 0; i <= BENCHMARK_NUM_PHASES; i++)
+    {
+        printf("%s", phase_names[i]);
+        print_time(stats[i].min);
+        print_time(stats[i].total / num_images);
+        print_time(stats[i].max);
+        printf("\n");
+    }
+}
+
+/*
+ * Load and display all existing images of the current game part, either from
+ * the separate NXI image files or from the given open image archive file.
+ */
+static void benchmark_game_part(uint8_t archive, bool use_archive)
+{
+    bool loaded;
+
+    for (uint16_t i = MIN_IMAGE; i <= MAX_IMAGE; i++)
+    {
+        memset(phase_time, 0, sizeof(phase_time));
+        last_mark_time = get_raster_time();
+
+        if (use_archive)
+        {
+            loaded = layer2_load_archive_screen(SHADOW_SCREEN, layer2_get_unused_access_palette(), archive, i, tmp_buffer);
+            if (loaded)
+            {
+                flip_image();
+            }
+        }
+        else
+        {
+            loaded = show_image(i);
+        }
+
+        if (loaded)
+        {
+            add_image_samples();
+        }
+    }
+}
+
+static void run_benchmark_pass(bool use_archive) __z88dk_fastcall
+{
+    uint8_t last_game_part = multiple_choice_game ? MAX_GAME_PART : MIN_GAME_PART;
+    uint8_t archive;
+
+    memset(stats, 0, sizeof(stats));
+    num_images = 0;
+
+    for (game_part = MIN_GAME_PART; game_part <= last_game_part; game_part++)
+    {
+        if (use_archive)
+        {
+            if (multiple_choice_game)
+            {
+                sprintf(filename, "gfx/%u/" IMAGE_ARCHIVE_FILE, game_part);
+            }
+            else
+            {
+                strcpy(filename, "gfx/" IMAGE_ARCHIVE_FILE);
+            }
+
+            errno = 0;
+            archive = esx_f_open(filename, ESX_MODE_R | ESX_MODE_OPEN_EXIST);
+            if (errno)
+            {
+                continue;
+            }
+
+            benchmark_game_part(archive, true);
+            esx_f_close(archive);
+        }
+        else
+        {
+            benchmark_game_part(0, false);
+        }
+    }
+
+    // Show the results in the text window.
+    layer2_config(false);
+    print_stats(use_archive ? IMAGE_ARCHIVE_FILE : "nxi files");
+    in_wait_nokey();
+    in_wait_key();
+    in_wait_nokey();
+    layer2_config(true);
+}
+
+static void run_benchmark(void)
+{
+    init_raster_time();
+    benchmark_running = true;
+
+    run_benchmark_pass(false);
+    run_benchmark_pass(true);
+
+    benchmark_running = false;
+
+    game_part = MIN_GAME_PART;
+    image = 0;
+    toggle_image(true);
+}
+
 void run_image_slideshow(void)
 {
     ZXN_WRITE_MMU0(255);
@@ -138,6 +347,9 @@ void run_image_slideshow(void)
             case 's':
                 toggle_game_part(true);
                 break;
+            case 'b':
+                run_benchmark();
+                break;
             default:
                 return;
         }
@@ -2,13 +2,31 @@
  * Stefan Bylund 2021
  *
  * Test module for displaying all location images. Press the O key to show the
- * previous image and the P key to show the next image. Press any other key to
- * exit the slideshow.
+ * previous image and the P key to show the next image. Press the B key to run
+ * the image benchmark. Press any other key to exit the slideshow.
  ******************************************************************************/
 
 #ifndef _IMAGE_SLIDESHOW_H
 #define _IMAGE_SLIDESHOW_H
 
+#include <stdint.h>
+
+#include "ide_friendly.h"
+
+// Phases of loading and displaying an image measured by the image benchmark.
+#define BENCHMARK_PHASE_OPEN 0
+#define BENCHMARK_PHASE_PALETTE 1
+#define BENCHMARK_PHASE_PIXELS 2
+#define BENCHMARK_PHASE_FLIP 3
+#define BENCHMARK_NUM_PHASES 4
+
 void run_image_slideshow(void);
 
+/*
+ * Mark the end of the given phase of loading and displaying an image. The time
+ * since the end of the previous phase is added to the statistics of the given
+ * phase if the image benchmark is running.
+ */
+void benchmark_mark(uint8_t phase) __z88dk_fastcall;
+
 #endif
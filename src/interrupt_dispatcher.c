@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of interrupt_dispatcher.h.
+ ******************************************************************************/
+
+#include <z80.h>
+#include <intrinsic.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "interrupt_dispatcher.h"
+#include "ide_friendly.h"
+
+typedef struct interrupt_handler_entry
+{
+    INTERRUPT_HANDLER handler;
+    uint8_t frames;
+    uint8_t countdown;
+} interrupt_handler_entry_t;
+
+volatile uint16_t frame_count = 0;
+
+// High 16 bits of the 32-bit frame counter.
+static volatile uint16_t frame_count_high = 0;
+
+static interrupt_handler_entry_t handlers[MAX_INTERRUPT_HANDLERS];
+
+static uint8_t num_handlers = 0;
+
+IM2_DEFINE_ISR(interrupt_dispatcher)
+{
+    interrupt_handler_entry_t *entry = handlers;
+
+    if (++frame_count == 0)
+    {
+        frame_count_high++;
+    }
+
+    for (uint8_t i = 0; i < num_handlers; i++, entry++)
+    {
+        if (--entry->countdown == 0)
+        {
+            entry->countdown = entry->frames;
+            entry->handler();
+        }
+    }
+}
+
+void init_interrupt_dispatcher(void)
+{
+    // Install interrupt dispatcher interrupt service routine.
+    intrinsic_di();
+    z80_bpoke(0xFDFD, 0xC3); // jp
+    z80_wpoke(0xFDFE, (uint16_t) interrupt_dispatcher);
+    intrinsic_ei();
+}
+
+uint32_t get_frame_count(void)
+{
+    uint16_t high;
+    uint16_t low;
+
+    // Read the high part again in case the low part wrapped in between.
+    do
+    {
+        high = frame_count_high;
+        low = frame_count;
+    }
+    while (high != frame_count_high);
+
+    return ((uint32_t) high << 16) | low;
+}
+
+bool add_interrupt_handler(INTERRUPT_HANDLER handler, uint8_t frames)
+{
+    interrupt_handler_entry_t *entry;
+    uint8_t num_same_frames = 0;
+
+    if (num_handlers == MAX_INTERRUPT_HANDLERS)
+    {
+        return false;
+    }
+
+    // Spread out the interrupt handlers with the same frame budget.
+    for (uint8_t i = 0; i < num_handlers; i++)
+    {
+        if (handlers[i].frames == frames)
+        {
+            num_same_frames++;
+        }
+    }
+
+    intrinsic_di();
+    entry = &handlers[num_handlers];
+    entry->handler = handler;
+    entry->frames = frames;
+    entry->countdown = (num_same_frames % frames) + 1;
+    num_handlers++;
+    intrinsic_ei();
+
+    return true;
+}
+
+void remove_interrupt_handler(INTERRUPT_HANDLER handler) __z88dk_fastcall
+{
+    intrinsic_di();
+    for (uint8_t i = 0; i < num_handlers; i++)
+    {
+        if (handlers[i].handler == handler)
+        {
+            num_handlers--;
+            for (; i < num_handlers; i++)
+            {
+                handlers[i] = handlers[i + 1];
+            }
+            break;
+        }
+    }
+    intrinsic_ei();
+}
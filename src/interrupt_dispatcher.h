@@ -0,0 +1,62 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Interrupt dispatcher for sharing the 50 Hz frame interrupt between several
+ * interrupt handlers, e.g. the mouse pointer update and the keyboard scanner.
+ *
+ * The dispatcher is installed as the IM2 ISR at 0xFDFD and calls the registered
+ * interrupt handlers in order of registration. Each interrupt handler has a
+ * frame budget, which is the number of frames between the calls to it. The
+ * calls to the interrupt handlers with the same frame budget are spread out
+ * over the frames so that incremental background work doesn't pile up in the
+ * same frame. The dispatcher also counts the frames.
+ ******************************************************************************/
+
+#ifndef _INTERRUPT_DISPATCHER_H
+#define _INTERRUPT_DISPATCHER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ide_friendly.h"
+
+// Max number of registered interrupt handlers.
+#define MAX_INTERRUPT_HANDLERS 8
+
+/*
+ * An interrupt handler is called with interrupts disabled and must be quick.
+ * It must not page out the main program or rely on the contents of MMU slots
+ * 0 to 2 since it may interrupt the program in the middle of anything.
+ */
+typedef void (*INTERRUPT_HANDLER)(void);
+
+/*
+ * Number of frames since the interrupt dispatcher was installed. Wraps around
+ * after 65536 frames (about 22 minutes).
+ */
+extern volatile uint16_t frame_count;
+
+/*
+ * Return the number of frames since the interrupt dispatcher was installed as
+ * a 32-bit counter, whose low 16 bits are frame_count. Wraps around after about
+ * 2.7 years.
+ */
+uint32_t get_frame_count(void);
+
+/*
+ * Install the interrupt dispatcher as the IM2 ISR.
+ */
+void init_interrupt_dispatcher(void);
+
+/*
+ * Register the given interrupt handler to be called once every given number of
+ * frames (1 - 255). Returns false if there are already MAX_INTERRUPT_HANDLERS
+ * registered interrupt handlers.
+ */
+bool add_interrupt_handler(INTERRUPT_HANDLER handler, uint8_t frames);
+
+/*
+ * Unregister the given interrupt handler.
+ */
+void remove_interrupt_handler(INTERRUPT_HANDLER handler) __z88dk_fastcall;
+
+#endif
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of key_queue.h.
+ *
+ * The keyboard is read with in_inkey(), which returns 0 if no key or more than
+ * one key is pressed. A key is put in the queue when it is first pressed and
+ * then repeatedly while it is held down. If the queue is full, the key is
+ * dropped.
+ ******************************************************************************/
+
+#include <intrinsic.h>
+#include <input.h>
+#include <stdint.h>
+
+#include "zconfig.h"
+#include "key_queue.h"
+#include "interrupt_dispatcher.h"
+#include "ide_friendly.h"
+
+#if USE_ADAPTIVE_TURBO
+#include "turbo.h"
+#endif
+
+// Size of the key queue, must be a power of 2.
+#define KEY_QUEUE_SIZE 32
+
+// Number of frames before a held key starts repeating (500 ms).
+#define KEY_REPEAT_START_FRAMES 25
+
+// Number of frames between key repeats.
+#define KEY_REPEAT_RATE_FRAMES 2
+
+static volatile uint8_t key_queue[KEY_QUEUE_SIZE];
+static volatile uint8_t key_queue_head = 0;
+static volatile uint8_t key_queue_tail = 0;
+
+static uint8_t last_key = 0;
+static uint8_t repeat_count;
+
+static void key_queue_scan(void)
+{
+    uint8_t key = (uint8_t) in_inkey();
+    uint8_t next_tail;
+
+    if (key == 0)
+    {
+        last_key = 0;
+        return;
+    }
+
+    if (key == last_key)
+    {
+        if (--repeat_count != 0)
+        {
+            return;
+        }
+        repeat_count = KEY_REPEAT_RATE_FRAMES;
+    }
+    else
+    {
+        last_key = key;
+        repeat_count = KEY_REPEAT_START_FRAMES;
+    }
+
+    next_tail = (key_queue_tail + 1) & (KEY_QUEUE_SIZE - 1);
+    if (next_tail != key_queue_head)
+    {
+        key_queue[key_queue_tail] = key;
+        key_queue_tail = next_tail;
+    }
+}
+
+void init_key_queue(void)
+{
+    key_queue_clear();
+
+    // Scan the keyboard each frame.
+    add_interrupt_handler(key_queue_scan, 1);
+}
+
+uint8_t key_queue_poll(void)
+{
+    uint8_t key;
+
+    if (key_queue_head == key_queue_tail)
+    {
+        return 0;
+    }
+
+    key = key_queue[key_queue_head];
+    key_queue_head = (key_queue_head + 1) & (KEY_QUEUE_SIZE - 1);
+    return key;
+}
+
+uint8_t key_queue_get(void)
+{
+    uint8_t key;
+#if USE_ADAPTIVE_TURBO
+    uint16_t idle_start = frame_count;
+#endif
+
+    while ((key = key_queue_poll()) == 0)
+    {
+#if USE_ADAPTIVE_TURBO
+        turbo_idle(frame_count - idle_start);
+#endif
+        intrinsic_halt();
+    }
+
+#if USE_ADAPTIVE_TURBO
+    turbo_busy();
+#endif
+
+    return key;
+}
+
+uint8_t key_queue_wait(uint16_t frames) __z88dk_fastcall
+{
+    uint8_t key;
+    uint16_t wait_start = frame_count;
+
+    while ((key = key_queue_poll()) == 0)
+    {
+        if ((uint16_t) (frame_count - wait_start) >= frames)
+        {
+            break;
+        }
+        intrinsic_halt();
+    }
+
+    return key;
+}
+
+void key_queue_clear(void)
+{
+    key_queue_head = key_queue_tail;
+}
+
+uint8_t key_queue_mark(void)
+{
+    return key_queue_tail;
+}
+
+void key_queue_restore(uint8_t mark) __z88dk_fastcall
+{
+    intrinsic_di();
+    key_queue_tail = mark;
+    intrinsic_ei();
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Type-ahead keyboard queue. Only compiled if USE_TYPE_AHEAD = 1.
+ *
+ * The keyboard is scanned each 1/50th second by an interrupt handler of the
+ * interrupt dispatcher and the typed keys are put in a ring buffer, which is
+ * consumed by the input terminal and os_read_char(). Keys typed while the
+ * interpreter is busy are therefore not lost.
+ ******************************************************************************/
+
+#ifndef _KEY_QUEUE_H
+#define _KEY_QUEUE_H
+
+#include <stdint.h>
+#include "ide_friendly.h"
+
+/*
+ * Initialize the keyboard queue and register its keyboard scanner with the
+ * interrupt dispatcher.
+ */
+void init_key_queue(void);
+
+/*
+ * Return the next key in the queue or 0 if the queue is empty.
+ */
+uint8_t key_queue_poll(void);
+
+/*
+ * Return the next key in the queue, waiting for it if the queue is empty.
+ */
+uint8_t key_queue_get(void);
+
+/*
+ * Return the next key in the queue, waiting for it for at most the given number
+ * of frames if the queue is empty. The CPU is halted between the frames. Return
+ * 0 if no key was typed in time.
+ */
+uint8_t key_queue_wait(uint16_t frames) __z88dk_fastcall;
+
+/*
+ * Discard all keys in the queue.
+ */
+void key_queue_clear(void);
+
+/*
+ * Return a mark for the current end of the queue.
+ */
+uint8_t key_queue_mark(void);
+
+/*
+ * Discard the keys put in the queue after the given mark was taken. Used for
+ * dropping the keys read directly from the keyboard, e.g. when waiting for a
+ * key press to continue after the scroll prompt, while keeping any keys typed
+ * ahead before that.
+ */
+void key_queue_restore(uint8_t mark) __z88dk_fastcall;
+
+#endif
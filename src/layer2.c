@@ -11,19 +11,120 @@
 #include <arch/zxn/esxdos.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 
 #include "zconfig.h"
 #include "layer2.h"
+#include "profiler.h"
 #include "ide_friendly.h"
 
+#if USE_IMAGE_SLIDESHOW
+#include "image_slideshow.h"
+#define BENCHMARK_MARK(phase) benchmark_mark(phase)
+#else
+#define BENCHMARK_MARK(phase)
+#endif
+
+// The image files are read via the image cache, if enabled.
+#if USE_IMAGE_CACHE
+#include "image_cache.h"
+#define LOAD_READ(filehandle, dst, len) image_cache_read(filehandle, dst, len)
+#define LOAD_SEEK(filehandle, offset) image_cache_seek(filehandle, offset)
+#else
+#define LOAD_READ(filehandle, dst, len) esx_f_read(filehandle, dst, len)
+#define LOAD_SEEK(filehandle, offset) esx_f_seek(filehandle, offset, ESX_SEEK_SET)
+#endif
+
 #define SCREEN_ADDRESS ((uint8_t *) 0x4000)
 
 #define GET_SCREEN_BASE_PAGE(screen)  (ZXN_READ_REG(screen) << 1)
 
+// Size of a full NXI image file (palette + 320x256 pixels).
+#define NXI_FILE_SIZE (512 + 0x14000UL)
+
+// Size of a 4-bit NXI image file (16 colour palette + 320x256 4-bit pixels).
+#define NXI4_FILE_SIZE (32 + 0xA000UL)
+
+#define NXI4_PALETTE_SIZE 32
+
+// Inset image header: magic "NXIS" (4 bytes), x (2 bytes), y (1 byte), width
+// (2 bytes), height (1 byte). The header is followed by the palette and the
+// pixels of the inset rectangle. The second byte of an NXI palette entry only
+// uses its lowest bit, so an NXI image can never start with the magic.
+#define INSET_MAGIC "NXIS"
+#define INSET_MAGIC_SIZE 4
+#define INSET_HEADER_SIZE 10
+
+// The frame image that the inset images are drawn inside.
+#define FRAME_IMAGE "1.nxi"
+#define FRAME_IMAGE_NUMBER 1
+
+// Number of entries in the directory of an image archive (images 0 - 799).
+#define ARCHIVE_NUM_IMAGES 800
+
+// Kinds of image pixel data loaded in steps by layer2_load_step().
+#define LOAD_NONE 0
+#define LOAD_PAGES 1
+#define LOAD_PAGES_4BIT 2
+#define LOAD_INSET 3
+
+// Image archive directory entry: offset and size of an image in the archive.
+typedef struct archive_entry
+{
+    uint32_t offset;
+    uint32_t size;
+} archive_entry_t;
+
 extern uint8_t max_image_height;
 
+// The layer 2 screen banks that currently hold the frame image (0 if none).
+static uint8_t frame_banks[2] = { 0, 0 };
+
+// The filename of the image being loaded or NULL if it's loaded from an image archive.
+static const char *image_filename;
+
+// The offset of the image being loaded in its file (0 unless it's loaded from an
+// image archive).
+static uint32_t image_offset;
+
+// State of the incremental loading of an image (see layer2_load_begin()).
+static uint8_t load_kind = LOAD_NONE;
+static uint8_t load_filehandle;
+static bool load_close_file;
+static bool load_frame_image;
+static bool load_finished;
+static bool load_failed;
+static uint8_t load_screen_bank;
+static uint8_t load_page;
+static uint16_t load_x;
+static uint16_t load_x_end;
+static uint8_t load_y;
+static uint8_t load_height;
+
+static bool has_frame(uint8_t bank) __z88dk_fastcall
+{
+    return (frame_banks[0] == bank) || (frame_banks[1] == bank);
+}
+
+static void set_frame(uint8_t bank, bool frame)
+{
+    if (frame_banks[0] == bank)
+    {
+        frame_banks[0] = 0;
+    }
+    if (frame_banks[1] == bank)
+    {
+        frame_banks[1] = 0;
+    }
+
+    if (frame)
+    {
+        frame_banks[(frame_banks[0] == 0) ? 0 : 1] = bank;
+    }
+}
+
 void layer2_flip_main_shadow_screen(void)
 {
     uint8_t main_screen_bank = ZXN_READ_REG(REG_LAYER_2_RAM_BANK);
@@ -97,6 +198,8 @@ void layer2_clear_screen(layer2_screen_t screen, uint8_t color)
 {
     uint8_t screen_base_page = GET_SCREEN_BASE_PAGE(screen);
 
+    set_frame(ZXN_READ_REG(screen), false);
+
     for (uint8_t page = screen_base_page; page < screen_base_page + 10; page++)
     {
         ZXN_WRITE_MMU2(page);
@@ -107,59 +210,438 @@ void layer2_clear_screen(layer2_screen_t screen, uint8_t color)
     ZXN_WRITE_MMU2(10);
 }
 
-void layer2_load_screen(layer2_screen_t screen,
-                        layer2_palette_t palette,
-                        const char *filename,
-                        uint8_t *buf_256)
+static bool is_frame_image(const char *filename) __z88dk_fastcall
 {
-    uint8_t filehandle;
-    uint8_t screen_base_page;
+    const char *name = strrchr(filename, '/');
+    return strcmp((name != NULL) ? name + 1 : filename, FRAME_IMAGE) == 0;
+}
 
-    // Skip parameter checking to save memory.
+static void load_screen_pages(uint8_t filehandle, uint8_t screen_base_page)
+{
+    // Load screen in 8 KB chunks using MMU slot 2 at address 0x4000.
 
-    // Note: Caller must ensure that the Spectrum ROM is in place.
+    for (uint8_t page = screen_base_page; page < screen_base_page + 10; page++)
+    {
+        ZXN_WRITE_MMU2(page);
 
-    errno = 0;
-    filehandle = esx_f_open(filename, ESX_MODE_R | ESX_MODE_OPEN_EXIST);
+        LOAD_READ(filehandle, SCREEN_ADDRESS, 0x2000);
+        if (errno)
+        {
+            break;
+        }
+    }
+}
+
+static void expand_page(void)
+{
+    uint8_t *src = SCREEN_ADDRESS + 0x1000;
+    uint8_t *dst = SCREEN_ADDRESS;
+
+    // Expand each packed byte to two 8-bit pixels, high nibble first.
+    do
+    {
+        uint8_t pixels = *src++;
+        *dst++ = pixels >> 4;
+        *dst++ = pixels & 0x0F;
+    }
+    while (dst != SCREEN_ADDRESS + 0x2000);
+}
+
+/*
+ * Seek to the given image in the given image archive file and return its size
+ * in bytes or 0 if the image doesn't exist. The archive starts with a
+ * directory of the offset and size of all images in it.
+ */
+static uint32_t seek_archive_image(uint8_t filehandle, uint16_t image)
+{
+    archive_entry_t entry;
+
+    if (image >= ARCHIVE_NUM_IMAGES)
+    {
+        return 0;
+    }
+
+    LOAD_SEEK(filehandle, (uint32_t) image * sizeof(archive_entry_t));
+    if (errno)
+    {
+        return 0;
+    }
+
+    LOAD_READ(filehandle, &entry, sizeof(archive_entry_t));
+    if (errno || (entry.size == 0))
+    {
+        return 0;
+    }
+
+    LOAD_SEEK(filehandle, entry.offset);
+    if (errno)
+    {
+        return 0;
+    }
+
+    image_offset = entry.offset;
+    return entry.size;
+}
+
+static bool load_frame(uint8_t filehandle, uint8_t screen_base_page, uint8_t *buf_256)
+{
+    uint8_t frame_filehandle;
+    uint32_t inset_offset;
+    char *name;
+
+    if (image_filename == NULL)
+    {
+        // The frame image is located in the same image archive as the inset
+        // image. Skip its palette, the inset image has its own.
+        inset_offset = image_offset;
+        if (seek_archive_image(filehandle, FRAME_IMAGE_NUMBER) == 0)
+        {
+            return false;
+        }
+        LOAD_SEEK(filehandle, image_offset + 512);
+        if (!errno)
+        {
+            load_screen_pages(filehandle, screen_base_page);
+        }
+
+        // Continue with the inset image after its header and palette.
+        LOAD_SEEK(filehandle, inset_offset + INSET_HEADER_SIZE + 512);
+        return !errno;
+    }
+
+    // The frame image is located in the same directory as the inset image.
+    strcpy((char *) buf_256, image_filename);
+    name = strrchr((char *) buf_256, '/');
+    strcpy((name != NULL) ? name + 1 : (char *) buf_256, FRAME_IMAGE);
+
+    frame_filehandle = esx_f_open((char *) buf_256, ESX_MODE_R | ESX_MODE_OPEN_EXIST);
     if (errno)
     {
-        return;
+        return false;
+    }
+
+    // Skip the palette of the frame image, the inset image has its own.
+    LOAD_SEEK(frame_filehandle, 512);
+    if (!errno)
+    {
+        load_screen_pages(frame_filehandle, screen_base_page);
+    }
+
+    esx_f_close(frame_filehandle);
+    return !errno;
+}
+
+/*
+ * Read the inset image header, if any, at the start of the image. Returns true
+ * and sets the inset rectangle if the image is an inset image. Otherwise, the
+ * image is rewound to its start and false is returned.
+ */
+static bool load_inset_header(uint8_t filehandle) __z88dk_fastcall
+{
+    uint8_t header[INSET_HEADER_SIZE];
+
+    LOAD_READ(filehandle, header, INSET_HEADER_SIZE);
+    if (errno)
+    {
+        return false;
+    }
+
+    if (memcmp(header, INSET_MAGIC, INSET_MAGIC_SIZE) != 0)
+    {
+        LOAD_SEEK(filehandle, image_offset);
+        return false;
+    }
+
+    load_x = header[4] | (header[5] << 8);
+    load_y = header[6];
+    load_x_end = load_x + (header[7] | (header[8] << 8));
+    load_height = header[9];
+    return true;
+}
+
+/*
+ * Start loading an image of the given size from the current position of the
+ * current load file into the given layer 2 screen. The image is either a full
+ * NXI image, a 4-bit NXI image or an inset image that is drawn inside the frame
+ * image. The palette and, if needed, the frame image are loaded immediately
+ * while the pixels are loaded in steps. Returns false if the image has an
+ * unknown format or can't be read.
+ */
+static bool load_begin(layer2_screen_t screen,
+                       layer2_palette_t palette,
+                       uint32_t size,
+                       uint8_t *buf_256)
+{
+    uint8_t screen_base_page;
+    bool is_inset;
+
+    load_screen_bank = ZXN_READ_REG(screen);
+    screen_base_page = load_screen_bank << 1;
+    load_page = screen_base_page;
+    load_failed = false;
+    load_finished = false;
+
+    // The image format is given by the inset header, if any, and otherwise by
+    // the file size. An inset image may have the same size as a 4-bit NXI image
+    // (e.g. 234x173 pixels), so the header must be checked first.
+    is_inset = load_inset_header(load_filehandle);
+    if (errno || (!is_inset && (size != NXI_FILE_SIZE) && (size != NXI4_FILE_SIZE)))
+    {
+        return false;
+    }
+
+    if (!is_inset && (size == NXI4_FILE_SIZE))
+    {
+        // A 4-bit image only uses the first 16 colours of the palette.
+        LOAD_READ(load_filehandle, buf_256, NXI4_PALETTE_SIZE);
+        if (errno)
+        {
+            return false;
+        }
+        layer2_set_palette(palette, (uint16_t *) buf_256, 16, 0);
+        BENCHMARK_MARK(BENCHMARK_PHASE_PALETTE);
+
+        set_frame(load_screen_bank, false);
+        load_kind = LOAD_PAGES_4BIT;
+        return true;
     }
 
     // Load palette.
 
-    esx_f_read(filehandle, buf_256, 256);
+    LOAD_READ(load_filehandle, buf_256, 256);
     if (errno)
     {
-        goto end;
+        return false;
     }
     layer2_set_palette(palette, (uint16_t *) buf_256, 128, 0);
-    esx_f_read(filehandle, buf_256, 256);
+    LOAD_READ(load_filehandle, buf_256, 256);
     if (errno)
     {
-        goto end;
+        return false;
     }
     layer2_set_palette(palette, (uint16_t *) buf_256, 128, 128);
+    BENCHMARK_MARK(BENCHMARK_PHASE_PALETTE);
 
-    // Load screen in 8 KB chunks using MMU slot 2 at address 0x4000.
+    if (!is_inset)
+    {
+        set_frame(load_screen_bank, false);
+        load_kind = LOAD_PAGES;
+        return true;
+    }
 
-    screen_base_page = GET_SCREEN_BASE_PAGE(screen);
+    // An inset image is loaded into a screen that holds the frame image.
+    if (!has_frame(load_screen_bank))
+    {
+        if (!load_frame(load_filehandle, screen_base_page, buf_256))
+        {
+            return false;
+        }
+        set_frame(load_screen_bank, true);
+    }
 
-    for (uint8_t page = screen_base_page; page < screen_base_page + 10; page++)
+    load_kind = LOAD_INSET;
+    return true;
+}
+
+bool layer2_load_begin(layer2_screen_t screen,
+                       layer2_palette_t palette,
+                       const char *filename,
+                       uint8_t *buf_256)
+{
+    struct esx_stat filestat;
+
+    // Skip parameter checking to save memory.
+
+    // Note: Caller must ensure that the Spectrum ROM is in place.
+
+    layer2_load_end(false);
+
+    errno = 0;
+    load_filehandle = esx_f_open(filename, ESX_MODE_R | ESX_MODE_OPEN_EXIST);
+    if (errno)
     {
-        ZXN_WRITE_MMU2(page);
+        return false;
+    }
 
-        esx_f_read(filehandle, SCREEN_ADDRESS, 0x2000);
-        if (errno)
+    esx_f_fstat(load_filehandle, &filestat);
+    BENCHMARK_MARK(BENCHMARK_PHASE_OPEN);
+    if (!errno)
+    {
+        image_filename = filename;
+        image_offset = 0;
+        load_close_file = true;
+        load_frame_image = is_frame_image(filename);
+        if (load_begin(screen, palette, filestat.size, buf_256))
         {
-            goto end;
+            // Restore original page in MMU slot 2.
+            ZXN_WRITE_MMU2(10);
+            return true;
         }
     }
 
-end:
     // Restore original page in MMU slot 2.
     ZXN_WRITE_MMU2(10);
-    esx_f_close(filehandle);
+    esx_f_close(load_filehandle);
+    load_kind = LOAD_NONE;
+    return false;
+}
+
+bool layer2_load_archive_begin(layer2_screen_t screen,
+                               layer2_palette_t palette,
+                               uint8_t archive,
+                               uint16_t image,
+                               uint8_t *buf_256)
+{
+    uint32_t size;
+    bool started;
+
+    // Skip parameter checking to save memory.
+
+    // Note: Caller must ensure that the Spectrum ROM is in place.
+
+    layer2_load_end(false);
+
+    errno = 0;
+    size = seek_archive_image(archive, image);
+    BENCHMARK_MARK(BENCHMARK_PHASE_OPEN);
+    if (size == 0)
+    {
+        return false;
+    }
+
+    image_filename = NULL;
+    load_filehandle = archive;
+    load_close_file = false;
+    load_frame_image = (image == FRAME_IMAGE_NUMBER);
+    started = load_begin(screen, palette, size, buf_256);
+    if (!started)
+    {
+        load_kind = LOAD_NONE;
+    }
+
+    // Restore original page in MMU slot 2.
+    ZXN_WRITE_MMU2(10);
+    return started;
+}
+
+bool layer2_load_step(void)
+{
+    uint8_t *dst;
+
+    if ((load_kind == LOAD_NONE) || load_finished)
+    {
+        return false;
+    }
+
+    PROFILE_BEGIN(PROFILE_IMAGE_LOAD);
+
+    errno = 0;
+
+    if (load_kind == LOAD_INSET)
+    {
+        // Load the inset columns of the next 8 KB page. Each page holds 32 columns.
+        ZXN_WRITE_MMU2((load_screen_bank << 1) + (uint8_t) (load_x >> 5));
+
+        do
+        {
+            dst = SCREEN_ADDRESS + (((uint8_t) load_x & 0x1F) << 8) + load_y;
+            LOAD_READ(load_filehandle, dst, load_height);
+            load_x++;
+        }
+        while (!errno && (load_x < load_x_end) && (((uint8_t) load_x & 0x1F) != 0));
+
+        load_finished = (load_x >= load_x_end);
+    }
+    else
+    {
+        ZXN_WRITE_MMU2(load_page);
+
+        if (load_kind == LOAD_PAGES_4BIT)
+        {
+            // Load the page as 4 KB of packed pixels into its upper half and
+            // expand them in place. The expansion never overtakes the packed
+            // pixels.
+            LOAD_READ(load_filehandle, SCREEN_ADDRESS + 0x1000, 0x1000);
+            if (!errno)
+            {
+                expand_page();
+            }
+        }
+        else
+        {
+            LOAD_READ(load_filehandle, SCREEN_ADDRESS, 0x2000);
+        }
+
+        load_page++;
+        load_finished = (load_page == (load_screen_bank << 1) + 10);
+    }
+
+    // Restore original page in MMU slot 2.
+    ZXN_WRITE_MMU2(10);
+
+    if (errno)
+    {
+        load_failed = true;
+        load_finished = true;
+    }
+
+    PROFILE_END(PROFILE_IMAGE_LOAD);
+
+    return !load_finished;
+}
+
+bool layer2_load_end(bool complete) __z88dk_fastcall
+{
+    bool loaded;
+
+    if (load_kind == LOAD_NONE)
+    {
+        return false;
+    }
+
+    if (complete)
+    {
+        while (layer2_load_step());
+    }
+
+    loaded = load_finished && !load_failed;
+
+    if (loaded)
+    {
+        if ((load_kind == LOAD_PAGES) && load_frame_image)
+        {
+            set_frame(load_screen_bank, true);
+        }
+        BENCHMARK_MARK(BENCHMARK_PHASE_PIXELS);
+    }
+
+    if (load_close_file)
+    {
+        esx_f_close(load_filehandle);
+    }
+
+    load_kind = LOAD_NONE;
+    return loaded;
+}
+
+void layer2_load_screen(layer2_screen_t screen,
+                        layer2_palette_t palette,
+                        const char *filename,
+                        uint8_t *buf_256)
+{
+    if (layer2_load_begin(screen, palette, filename, buf_256))
+    {
+        layer2_load_end(true);
+    }
+}
+
+bool layer2_load_archive_screen(layer2_screen_t screen,
+                                layer2_palette_t palette,
+                                uint8_t archive,
+                                uint16_t image,
+                                uint8_t *buf_256)
+{
+    return layer2_load_archive_begin(screen, palette, archive, image, buf_256) && layer2_load_end(true);
 }
 
 void wait_video_line(uint16_t line) __z88dk_fastcall
@@ -12,9 +12,13 @@
 
 #include <arch/zxn.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "ide_friendly.h"
 
+// Image archive file created by the convert_gfx and convert_bitmap tools.
+#define IMAGE_ARCHIVE_FILE "images.pak"
+
 typedef enum layer2_screen
 {
     MAIN_SCREEN = REG_LAYER_2_RAM_BANK,
@@ -71,6 +75,45 @@ void layer2_load_screen(layer2_screen_t screen,
                         const char *filename,
                         uint8_t *buf_256);
 
+/*
+ * Load the given image from the given image archive file, which is kept open
+ * by the caller, into the given layer 2 screen and its palette into the given
+ * layer 2 palette. Returns false if the image doesn't exist in the archive or
+ * couldn't be loaded.
+ */
+bool layer2_load_archive_screen(layer2_screen_t screen,
+                                layer2_palette_t palette,
+                                uint8_t archive,
+                                uint16_t image,
+                                uint8_t *buf_256);
+
+/*
+ * Incremental loading of an image into a layer 2 screen. The image is opened
+ * and its palette (and frame image, if needed) loaded by layer2_load_begin()
+ * or layer2_load_archive_begin(), which return false if the image couldn't be
+ * opened. The pixels are then loaded one 8 KB screen page at a time by calling
+ * layer2_load_step(), which returns true as long as there are more pages to
+ * load, so that the caller can do other work in between. The loading is ended
+ * by layer2_load_end(), which first loads the remaining pages if complete is
+ * true. It returns true if the whole image was loaded. Starting to load a new
+ * image abandons any ongoing load. The buf_256 buffer is only used when
+ * starting to load an image. It is assumed that the ROM is paged in.
+ */
+bool layer2_load_begin(layer2_screen_t screen,
+                       layer2_palette_t palette,
+                       const char *filename,
+                       uint8_t *buf_256);
+
+bool layer2_load_archive_begin(layer2_screen_t screen,
+                               layer2_palette_t palette,
+                               uint8_t archive,
+                               uint16_t image,
+                               uint8_t *buf_256);
+
+bool layer2_load_step(void);
+
+bool layer2_load_end(bool complete) __z88dk_fastcall;
+
 void wait_video_line(uint16_t line) __z88dk_fastcall;
 
 #endif
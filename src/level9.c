@@ -28,6 +28,12 @@
  *  #picture <n>  show picture <n>
  *  #seed <n>     set the random number seed to the value <n>
  *  #play         plays back a script file as the input to the game
+ *  #undo [<n>]   restores the game state as it was before the last <n>
+ *                commands (default 1), only available if USE_UNDO is enabled
+ *  #profile      prints the time spent in the profiled parts of the interpreter,
+ *                only available if USE_PROFILER is enabled
+ *  #pages        prints the owners of the spare MMU pages, only available if
+ *                USE_PAGE_DUMP is enabled
  *
  ******************************************************************************/
 
@@ -87,8 +93,11 @@
 #include <stropts.h>
 #include <errno.h>
 
+#include "zconfig.h"
 #include "level9.h"
 #include "memory_paging.h"
+#include "profiler.h"
+#include "page_allocator.h"
 #include "ide_friendly.h"
 
 #define GAME_INFO_FILE "gamedata.txt"
@@ -104,16 +113,89 @@
 // Backup of workspace used when loading game state.
 #define WORKSPACE_BACKUP_PAGE 2
 
+#ifndef MMU2_ADDRESS
 #define MMU2_ADDRESS ((uint8_t *) 0x4000)
+#endif
 
 #define ESX_INVALID_FILE_HANDLE 0xFF
 
+// The snapshot data covers var_table, list_area and stack (2816 bytes), which
+// are tracked in blocks of SNAPSHOT_BLOCK_SIZE bytes.
+#define SNAPSHOT_DATA ((uint8_t *) workspace.var_table)
+#define SNAPSHOT_DATA_SIZE (sizeof(save_struct_t) + STACK_SIZE * sizeof(uint16_t))
+#define SNAPSHOT_BLOCK_SIZE 64
+#define SNAPSHOT_NUM_BLOCKS (SNAPSHOT_DATA_SIZE / SNAPSHOT_BLOCK_SIZE)
+#define SNAPSHOT_LIST_AREA_BLOCK (VAR_TABLE_SIZE * sizeof(uint16_t) / SNAPSHOT_BLOCK_SIZE)
+#define SNAPSHOT_STACK_BLOCK (sizeof(save_struct_t) / SNAPSHOT_BLOCK_SIZE)
+
+// Mark the snapshot block containing the given var_table index, list_area
+// offset or stack index as changed.
+#define MARK_VAR_BLOCK(i) (block_generation[(i) >> 5] = snapshot_generation)
+#define MARK_LIST_BLOCK(offset) (block_generation[SNAPSHOT_LIST_AREA_BLOCK + ((offset) >> 6)] = snapshot_generation)
+#define MARK_STACK_BLOCK(i) (block_generation[SNAPSHOT_STACK_BLOCK + ((i) >> 5)] = snapshot_generation)
+
+// Max number of bytes of list 9 written by the input routine and driver calls.
+#define LIST9_WRITE_SIZE 0x28
+
+// The vocabulary index starts with a table of the offsets of the word records
+// of the buckets, where the first entry is for def_dict and the following
+// entries are for the buckets in dict_data.
+#define VOCABULARY_INDEX_SIZE (NUM_VOCABULARY_PAGES * 0x2000U)
+#define VOCABULARY_MAX_BUCKETS 0x68
+#define VOCABULARY_NO_OFFSET 0xFFFF
+
+// Vocabulary index records that are not word records.
+#define VOCABULARY_JUMP 0xFE
+#define VOCABULARY_END 0xFF
+
+// The vocabulary index of V2 games is a sorted table of vocabulary entries.
+#define VOCABULARY_KEY_SIZE 13
+#define VOCABULARY_MAX_ENTRIES (VOCABULARY_INDEX_SIZE / sizeof(vocabulary_entry_t))
+
+// Results of looking up a word in the vocabulary index of V2 games.
+#define VOCABULARY_NOT_FOUND 0
+#define VOCABULARY_FOUND 1
+#define VOCABULARY_PREFIX 2
+
+#if USE_UNDO
+#define UNDO_BITMAP_SIZE ((SNAPSHOT_NUM_BLOCKS + 7) / 8)
+
+// The undo ring occupies the undo pages after the current snapshot page.
+#define UNDO_RING_SIZE ((NUM_UNDO_PAGES - 1) * 0x2000U)
+
+// Max number of undo records in the undo ring, must be a power of 2.
+#define UNDO_MAX_RECORDS 64
+#endif
+
 typedef struct save_struct
 {
     uint16_t var_table[VAR_TABLE_SIZE];
     uint8_t list_area[LIST_AREA_SIZE];
 } save_struct_t;
 
+/*
+ * Vocabulary entry of a V2 game. The key is the lower-case null-terminated word
+ * and end is the address of the last character of the word in the dictionary,
+ * which is followed by the word code.
+ */
+typedef struct vocabulary_entry
+{
+    uint8_t key[VOCABULARY_KEY_SIZE];
+    uint16_t end;
+    uint8_t code;
+} vocabulary_entry_t;
+
+#if USE_UNDO
+typedef struct undo_record
+{
+    uint16_t code_ptr;
+    uint16_t stack_ptr;
+    uint16_t random_seed;
+    uint8_t changed_blocks[UNDO_BITMAP_SIZE];
+    // Followed by the changed blocks.
+} undo_record_t;
+#endif
+
 uint8_t tmp_buffer[256];
 
 // Size of the actual paged memory used by the game (<= 64 KB).
@@ -161,6 +243,29 @@ static uint8_t unpack_buf[8];
 static uint8_t unpack_d3;
 static uint8_t three_chars[34];
 
+/*
+ * The dictionary words of V3/V4 games are decoded once when the game is loaded
+ * into the vocabulary index, which is then scanned by the input routine instead
+ * of unpacking the 5-bit dictionary codes of each word. Each bucket is a stream
+ * of word records consisting of the number of characters kept from the previous
+ * word followed by the remaining null-terminated characters of the word. The
+ * stream ends with a VOCABULARY_END record or continues elsewhere at the offset
+ * given by a VOCABULARY_JUMP record when it reaches the start of another bucket.
+ * The input routine falls back to unpacking the dictionary if the index does
+ * not fit in the vocabulary pages.
+ *
+ * The dictionary words of V2 games are extracted when the game is loaded into
+ * a table sorted by word and dictionary address, which is binary searched by
+ * the input routine for the first dictionary word in dictionary order that the
+ * input word matches. The input routine falls back to walking the dictionary
+ * if the table does not fit in the vocabulary pages or if the input word is
+ * longer than the first dictionary word it matches, in which case the walk
+ * continues in the middle of the next dictionary word.
+ */
+static bool vocabulary_indexed = false;
+static uint16_t vocabulary_offset;
+static uint16_t vocabulary_size;
+
 static uint8_t last_char = '.';
 static uint8_t last_actual_char = 0;
 static uint8_t d5 = 0;
@@ -181,6 +286,35 @@ static uint16_t num_object_found;
 static uint16_t search_depth;
 static uint16_t init_hi_search_pos;
 
+/*
+ * Each snapshot block records the snapshot generation in which it was last
+ * written. A user of snapshots, i.e. a RAM SAVE slot or the undo snapshot,
+ * records the snapshot generation in which its snapshot was taken. The blocks
+ * that have changed since then are those with a block generation greater than
+ * or equal to the snapshot generation of the snapshot. A snapshot generation of
+ * 0 means that all blocks must be considered as changed.
+ */
+static uint8_t block_generation[SNAPSHOT_NUM_BLOCKS];
+static uint8_t snapshot_generation = 1;
+static uint8_t ram_save_generation[RAM_SAVE_SLOTS];
+
+#if USE_UNDO
+/*
+ * The undo area consists of a copy of the game state as it was before the last
+ * command (the current snapshot) and a ring of undo records. Each undo record
+ * contains the blocks of the previous snapshot that differ from the next one.
+ * Stepping back one command is done by restoring the current snapshot and then
+ * applying the newest undo record to it, which makes it the current snapshot.
+ */
+static bool undo_snapshot_valid = false;
+static uint8_t undo_generation;
+static undo_record_t undo_snapshot_header; // changed_blocks is unused
+static uint16_t undo_offsets[UNDO_MAX_RECORDS];
+static uint8_t undo_first;
+static uint8_t undo_count;
+static uint16_t undo_pos;
+#endif
+
 #ifdef CODEFOLLOW
 #define CODEFOLLOW_FILE "codefollow.txt"
 
@@ -278,6 +412,11 @@ static uint8_t *driver_calls[] =
 
 /* Prototypes */
 static uint8_t get_long_code(void);
+static void build_vocabulary_index(void);
+static void build_vocabulary_index_v2(void);
+#if USE_UNDO
+static void undo_reset(void);
+#endif
 
 #ifdef CODEFOLLOW
 static void cf_print(char *format, ...)
@@ -494,6 +633,7 @@ static bool init_game(uint8_t *filename) __z88dk_fastcall
         case L9_V2:
             start_md = L9WORD(header_ptr + 0x0);
             start_md_v2 = L9WORD(header_ptr + 0x2);
+            build_vocabulary_index_v2();
             break;
         case L9_V3:
         case L9_V4:
@@ -504,6 +644,7 @@ static bool init_game(uint8_t *filename) __z88dk_fastcall
             dict_data = L9WORD(header_ptr + 0x0a);
             dict_data_len = L9WORD(header_ptr + 0x0c);
             word_table = L9WORD(header_ptr + 0xe);
+            build_vocabulary_index();
             break;
     }
 
@@ -535,6 +676,9 @@ static bool int_load_game(uint8_t *filename) __z88dk_fastcall
 
     running = false;
     in_buffer_ptr = NULL;
+#if USE_UNDO
+    undo_reset();
+#endif
 
     if (!init_game(filename))
     {
@@ -543,7 +687,11 @@ static bool int_load_game(uint8_t *filename) __z88dk_fastcall
 
     code_ptr = acode_ptr;
     random_seed = const_seed ? const_seed : seed();
-    strcpy(game_file, filename);
+    // Called with game_file itself when loading the next part of a multi-part game.
+    if (filename != game_file)
+    {
+        strcpy(game_file, filename);
+    }
 
     return running = true;
 }
@@ -985,11 +1133,13 @@ static uint16_t get_con(void)
 
 static uint16_t *get_var(void)
 {
+    uint8_t i = *effective(code_ptr++);
+    MARK_VAR_BLOCK(i);
 #ifndef CODEFOLLOW
-    return workspace.var_table + *effective(code_ptr++);
+    return workspace.var_table + i;
 #else
     cf_var2 = cf_var;
-    cf_var = workspace.var_table + *effective(code_ptr++);
+    cf_var = workspace.var_table + i;
     return cf_var;
 #endif
 }
@@ -1045,6 +1195,7 @@ static void int_gosub(void)
 #endif
 
     new_code_ptr = get_addr();
+    MARK_STACK_BLOCK(workspace.stack_ptr);
     workspace.stack[workspace.stack_ptr++] = code_ptr;
     code_ptr = new_code_ptr;
 
@@ -1080,6 +1231,7 @@ static void print_number(void)
 
 static void messagev(void)
 {
+    PROFILE_BEGIN(PROFILE_PRINT_MESSAGE);
     if (game_type <= L9_V2)
     {
         print_message_v2(get_var_val());
@@ -1088,10 +1240,12 @@ static void messagev(void)
     {
         print_message(get_var_val());
     }
+    PROFILE_END(PROFILE_PRINT_MESSAGE);
 }
 
 static void messagec(void)
 {
+    PROFILE_BEGIN(PROFILE_PRINT_MESSAGE);
     if (game_type <= L9_V2)
     {
         print_message_v2(get_con());
@@ -1100,6 +1254,7 @@ static void messagec(void)
     {
         print_message(get_con());
     }
+    PROFILE_END(PROFILE_PRINT_MESSAGE);
 }
 
 static void random_number(uint8_t *a6) __z88dk_fastcall
@@ -1173,6 +1328,48 @@ static void driver(uint8_t d0_in, uint8_t *a6)
     }
 }
 
+static void mark_all_blocks(void)
+{
+    memset(block_generation, snapshot_generation, sizeof(block_generation));
+}
+
+static void mark_list9_blocks(void)
+{
+    uint16_t offset = list9_start_ptr - workspace.list_area;
+    uint16_t block = SNAPSHOT_LIST_AREA_BLOCK + (offset >> 6);
+    uint16_t last_block = SNAPSHOT_LIST_AREA_BLOCK + ((offset + LIST9_WRITE_SIZE - 1) >> 6);
+
+    if (block < SNAPSHOT_NUM_BLOCKS)
+    {
+        block_generation[block] = snapshot_generation;
+    }
+    if (last_block < SNAPSHOT_NUM_BLOCKS)
+    {
+        block_generation[last_block] = snapshot_generation;
+    }
+}
+
+/*
+ * Start a new snapshot generation and return it. Must be called after a
+ * snapshot has been taken and the returned generation recorded for it.
+ */
+static uint8_t next_snapshot_generation(void)
+{
+    if (++snapshot_generation == 0)
+    {
+        // The snapshot generation has wrapped around, consider all blocks in
+        // all existing snapshots as changed.
+        memset(block_generation, 1, sizeof(block_generation));
+        memset(ram_save_generation, 0, sizeof(ram_save_generation));
+#if USE_UNDO
+        undo_generation = 0;
+#endif
+        snapshot_generation = 2;
+    }
+
+    return snapshot_generation;
+}
+
 /* The RAM SAVE area is RAM_SAVE_SLOTS x sizeof(save_struct_t) = 10 x 2560 =
  * 25600 bytes. The RAM SAVE command saves the current position and the RAM
  * RESTORE/LOAD command restores it. Implicit RAM SAVEs are done automatically
@@ -1187,7 +1384,20 @@ static void ram_save(uint8_t i) __z88dk_fastcall
 
     uint8_t memory_page = current_page;
     uint8_t *ram_save_slot = effective_ram_save(i);
-    memcpy(ram_save_slot, workspace.var_table, sizeof(save_struct_t));
+    uint8_t generation = ram_save_generation[i];
+    uint16_t offset = 0;
+
+    // Only copy the blocks that have changed since the last RAM SAVE to the slot.
+    for (uint8_t block = 0; block < SNAPSHOT_STACK_BLOCK; block++)
+    {
+        if (block_generation[block] >= generation)
+        {
+            memcpy(ram_save_slot + offset, SNAPSHOT_DATA + offset, SNAPSHOT_BLOCK_SIZE);
+        }
+        offset += SNAPSHOT_BLOCK_SIZE;
+    }
+    ram_save_generation[i] = next_snapshot_generation();
+
     current_page = memory_page;
     page_in_game();
 }
@@ -1200,7 +1410,21 @@ static void ram_load(uint8_t i) __z88dk_fastcall
 
     uint8_t memory_page = current_page;
     uint8_t *ram_save_slot = effective_ram_save(i);
-    memcpy(workspace.var_table, ram_save_slot, sizeof(save_struct_t));
+    uint8_t generation = ram_save_generation[i];
+    uint16_t offset = 0;
+
+    // Only restore the blocks that have changed since the slot was saved.
+    for (uint8_t block = 0; block < SNAPSHOT_STACK_BLOCK; block++)
+    {
+        if (block_generation[block] >= generation)
+        {
+            memcpy(SNAPSHOT_DATA + offset, ram_save_slot + offset, SNAPSHOT_BLOCK_SIZE);
+            block_generation[block] = snapshot_generation;
+        }
+        offset += SNAPSHOT_BLOCK_SIZE;
+    }
+    ram_save_generation[i] = next_snapshot_generation();
+
     current_page = memory_page;
     page_in_game();
 }
@@ -1210,6 +1434,8 @@ static void call_driver(void)
     uint8_t *a6 = list9_start_ptr;
     uint8_t d0 = *a6++;
 
+    mark_list9_blocks();
+
 #ifdef CODEFOLLOW
     cf_print(" %s", driver_calls[d0]);
 #endif
@@ -1387,6 +1613,8 @@ static void normal_restore(void)
         memcpy(&workspace, MMU2_ADDRESS, sizeof(game_state_t));
         ZXN_WRITE_MMU2(10);
     }
+
+    mark_all_blocks();
 }
 
 static void restore(void)
@@ -1425,6 +1653,8 @@ static void restore(void)
         memcpy(&workspace, MMU2_ADDRESS, sizeof(game_state_t));
         ZXN_WRITE_MMU2(10);
     }
+
+    mark_all_blocks();
 }
 
 static void playback(void)
@@ -1449,9 +1679,201 @@ static void playback(void)
     }
 }
 
+#if USE_UNDO
+static void undo_reset(void)
+{
+    undo_snapshot_valid = false;
+    undo_generation = 0;
+    undo_first = 0;
+    undo_count = 0;
+    undo_pos = 0;
+}
+
+static uint8_t *undo_alloc_record(uint16_t size) __z88dk_fastcall
+{
+    uint16_t record_pos;
+
+    // Undo records are never split at the end of the undo ring.
+    if (undo_pos + size > UNDO_RING_SIZE)
+    {
+        undo_pos = 0;
+    }
+
+    // Discard the oldest undo records that would be overwritten.
+    while (undo_count != 0)
+    {
+        uint16_t oldest_pos = undo_offsets[undo_first];
+        if ((undo_count < UNDO_MAX_RECORDS) &&
+            ((oldest_pos < undo_pos) || (oldest_pos >= undo_pos + size)))
+        {
+            break;
+        }
+        undo_first = (undo_first + 1) & (UNDO_MAX_RECORDS - 1);
+        undo_count--;
+    }
+
+    record_pos = undo_pos;
+    undo_offsets[(undo_first + undo_count) & (UNDO_MAX_RECORDS - 1)] = record_pos;
+    undo_count++;
+    undo_pos += size;
+
+    return effective_undo(record_pos);
+}
+
+/*
+ * Take a snapshot of the game state before a new command is processed. Only the
+ * blocks that have been written since the current snapshot and differ from it
+ * are saved in a new undo record.
+ * Note: The current snapshot page must be paged in to MMU slot 2.
+ */
+static void undo_save_snapshot(void)
+{
+    uint8_t changed_blocks[UNDO_BITMAP_SIZE];
+    uint8_t num_changed_blocks = 0;
+    undo_record_t *record;
+    uint8_t *record_ptr;
+    uint16_t offset;
+
+    memset(changed_blocks, 0, sizeof(changed_blocks));
+
+    offset = 0;
+    for (uint8_t i = 0; i < SNAPSHOT_NUM_BLOCKS; i++)
+    {
+        if ((block_generation[i] >= undo_generation) &&
+            memcmp(MMU2_ADDRESS + offset, SNAPSHOT_DATA + offset, SNAPSHOT_BLOCK_SIZE))
+        {
+            changed_blocks[i >> 3] |= 1 << (i & 7);
+            num_changed_blocks++;
+        }
+        offset += SNAPSHOT_BLOCK_SIZE;
+    }
+
+    record = (undo_record_t *) undo_alloc_record(sizeof(undo_record_t) + num_changed_blocks * SNAPSHOT_BLOCK_SIZE);
+    memcpy(record, &undo_snapshot_header, sizeof(undo_record_t));
+    memcpy(record->changed_blocks, changed_blocks, sizeof(changed_blocks));
+    record_ptr = (uint8_t *) (record + 1);
+
+    offset = 0;
+    for (uint8_t i = 0; i < SNAPSHOT_NUM_BLOCKS; i++)
+    {
+        if (changed_blocks[i >> 3] & (1 << (i & 7)))
+        {
+            memcpy(record_ptr, MMU2_ADDRESS + offset, SNAPSHOT_BLOCK_SIZE);
+            memcpy(MMU2_ADDRESS + offset, SNAPSHOT_DATA + offset, SNAPSHOT_BLOCK_SIZE);
+            record_ptr += SNAPSHOT_BLOCK_SIZE;
+        }
+        offset += SNAPSHOT_BLOCK_SIZE;
+    }
+}
+
+/*
+ * Apply the newest undo record to the current snapshot and discard it.
+ * Note: The current snapshot page must be paged in to MMU slot 2.
+ */
+static void undo_apply_record(void)
+{
+    uint16_t record_pos;
+    undo_record_t *record;
+    uint8_t *record_ptr;
+    uint16_t offset;
+
+    undo_count--;
+    record_pos = undo_offsets[(undo_first + undo_count) & (UNDO_MAX_RECORDS - 1)];
+    record = (undo_record_t *) effective_undo(record_pos);
+    memcpy(&undo_snapshot_header, record, sizeof(undo_record_t));
+    record_ptr = (uint8_t *) (record + 1);
+
+    offset = 0;
+    for (uint8_t i = 0; i < SNAPSHOT_NUM_BLOCKS; i++)
+    {
+        if (undo_snapshot_header.changed_blocks[i >> 3] & (1 << (i & 7)))
+        {
+            memcpy(MMU2_ADDRESS + offset, record_ptr, SNAPSHOT_BLOCK_SIZE);
+            record_ptr += SNAPSHOT_BLOCK_SIZE;
+        }
+        offset += SNAPSHOT_BLOCK_SIZE;
+    }
+
+    // The space of the newest undo record can be reused.
+    undo_pos = record_pos;
+}
+
+static void undo_snapshot(void)
+{
+    uint8_t memory_page = current_page;
+
+    ZXN_WRITE_MMU2(undo_base_page);
+    if (undo_snapshot_valid)
+    {
+        undo_save_snapshot();
+    }
+    else
+    {
+        memcpy(MMU2_ADDRESS, SNAPSHOT_DATA, SNAPSHOT_DATA_SIZE);
+        undo_snapshot_valid = true;
+    }
+    ZXN_WRITE_MMU2(10);
+    undo_generation = next_snapshot_generation();
+
+    undo_snapshot_header.code_ptr = code_ptr;
+    undo_snapshot_header.stack_ptr = workspace.stack_ptr;
+    undo_snapshot_header.random_seed = random_seed;
+
+    current_page = memory_page;
+    page_in_game();
+}
+
+static void undo(uint16_t num_commands) __z88dk_fastcall
+{
+    uint8_t memory_page = current_page;
+
+    if (num_commands == 0)
+    {
+        return;
+    }
+
+    if (!undo_snapshot_valid || (num_commands > undo_count + 1))
+    {
+        print_string("\rUnable to undo that far.\r");
+        return;
+    }
+
+    ZXN_WRITE_MMU2(undo_base_page);
+
+    while (--num_commands)
+    {
+        undo_apply_record();
+    }
+
+    memcpy(SNAPSHOT_DATA, MMU2_ADDRESS, SNAPSHOT_DATA_SIZE);
+    mark_all_blocks();
+    code_ptr = undo_snapshot_header.code_ptr;
+    workspace.stack_ptr = undo_snapshot_header.stack_ptr;
+    random_seed = undo_snapshot_header.random_seed;
+
+    // The snapshot before the restored one becomes the current snapshot.
+    if (undo_count != 0)
+    {
+        undo_apply_record();
+    }
+    else
+    {
+        undo_snapshot_valid = false;
+    }
+
+    ZXN_WRITE_MMU2(10);
+
+    current_page = memory_page;
+    page_in_game();
+
+    print_string("\rUndone.\r");
+}
+#endif
+
 static void clear_workspace(void)
 {
     memset(workspace.var_table, 0, sizeof(workspace.var_table));
+    mark_all_blocks();
 }
 
 static void clear_stack(void)
@@ -1699,6 +2121,185 @@ static bool init_unpack(uint16_t ptr) __z88dk_fastcall
     return unpack_word();
 }
 
+static uint16_t get_bucket_address(uint8_t bucket) __z88dk_fastcall
+{
+    return bucket ? L9WORD(effective(dict_data + ((bucket - 1) << 2))) : def_dict;
+}
+
+static uint16_t get_bucket_offset(uint8_t bucket) __z88dk_fastcall
+{
+    return L9WORD(effective_vocabulary(bucket << 1));
+}
+
+static void set_bucket_offset(uint8_t bucket, uint16_t offset)
+{
+    L9SETWORD(effective_vocabulary(bucket << 1), offset);
+}
+
+static uint16_t find_indexed_bucket(uint8_t num_buckets, uint16_t addr)
+{
+    for (uint8_t i = 0; i < num_buckets; i++)
+    {
+        uint16_t offset = get_bucket_offset(i);
+        if (offset != VOCABULARY_NO_OFFSET && get_bucket_address(i) == addr)
+        {
+            return offset;
+        }
+    }
+
+    return VOCABULARY_NO_OFFSET;
+}
+
+static bool put_vocabulary(uint16_t *offset, uint8_t value)
+{
+    if (*offset >= VOCABULARY_INDEX_SIZE)
+    {
+        return false;
+    }
+
+    *effective_vocabulary((*offset)++) = value;
+    return true;
+}
+
+static void build_vocabulary_index(void)
+{
+    uint8_t num_buckets;
+    uint16_t offset;
+
+    vocabulary_indexed = false;
+    num_buckets = ((dict_data_len < VOCABULARY_MAX_BUCKETS) ? dict_data_len : VOCABULARY_MAX_BUCKETS) + 1;
+
+    for (uint8_t i = 0; i < num_buckets; i++)
+    {
+        set_bucket_offset(i, VOCABULARY_NO_OFFSET);
+    }
+
+    offset = num_buckets << 1;
+
+    /*
+     * The buckets are decoded in order of descending dictionary address so that
+     * a bucket can jump to the already decoded words of the next bucket when it
+     * reaches its start with the same unpacking state.
+     */
+    for (uint8_t n = 0; n < num_buckets; n++)
+    {
+        uint8_t bucket = 0;
+        uint16_t bucket_addr = 0;
+        uint16_t jump_offset;
+
+        for (uint8_t i = 0; i < num_buckets; i++)
+        {
+            uint16_t addr = get_bucket_address(i);
+            if (get_bucket_offset(i) == VOCABULARY_NO_OFFSET && addr >= bucket_addr)
+            {
+                bucket = i;
+                bucket_addr = addr;
+            }
+        }
+
+        jump_offset = find_indexed_bucket(num_buckets, bucket_addr);
+        if (jump_offset != VOCABULARY_NO_OFFSET)
+        {
+            set_bucket_offset(bucket, jump_offset);
+            continue;
+        }
+
+        set_bucket_offset(bucket, offset);
+        init_dict(bucket_addr);
+        unpack_d3 = 0x1c;
+
+        while (true)
+        {
+            uint8_t d0 = unpack_d3 & 3;
+
+            if (unpack_d3 == 0x1c && unpack_count == 8 && dict_ptr != bucket_addr)
+            {
+                jump_offset = find_indexed_bucket(num_buckets, dict_ptr);
+                if (jump_offset != VOCABULARY_NO_OFFSET)
+                {
+                    if (!put_vocabulary(&offset, VOCABULARY_JUMP) ||
+                        !put_vocabulary(&offset, (uint8_t) jump_offset) ||
+                        !put_vocabulary(&offset, (uint8_t) (jump_offset >> 8)))
+                    {
+                        return;
+                    }
+                    break;
+                }
+            }
+
+            if (unpack_word())
+            {
+                if (!put_vocabulary(&offset, VOCABULARY_END))
+                {
+                    return;
+                }
+                break;
+            }
+
+            if (!put_vocabulary(&offset, d0))
+            {
+                return;
+            }
+            do
+            {
+                if (!put_vocabulary(&offset, three_chars[d0]))
+                {
+                    return;
+                }
+            } while (three_chars[d0++] != 0);
+        }
+    }
+
+    vocabulary_indexed = true;
+}
+
+static bool next_vocabulary_word(void)
+{
+    uint8_t *a0 = effective_vocabulary(vocabulary_offset);
+    uint8_t *a3;
+    uint8_t d0;
+
+    if (*a0 == VOCABULARY_JUMP)
+    {
+        vocabulary_offset = L9WORD(a0 + 1);
+        a0 = effective_vocabulary(vocabulary_offset);
+    }
+
+    if (*a0 == VOCABULARY_END)
+    {
+        return true;
+    }
+
+    a3 = (uint8_t *) three_chars + *a0++;
+    vocabulary_offset++;
+    do
+    {
+        d0 = *a0++;
+        *a3++ = d0;
+        vocabulary_offset++;
+    } while (d0 != 0);
+
+    return false;
+}
+
+static bool next_word(void)
+{
+    return vocabulary_indexed ? next_vocabulary_word() : unpack_word();
+}
+
+static void init_word_scan(uint8_t bucket, uint16_t ptr)
+{
+    if (vocabulary_indexed)
+    {
+        vocabulary_offset = get_bucket_offset(bucket);
+        next_vocabulary_word();
+    }
+    else
+    {
+        init_unpack(ptr);
+    }
+}
+
 static bool part_word(uint8_t c) __z88dk_fastcall
 {
     c = tolower(c);
@@ -1799,7 +2400,7 @@ static bool check_hash(void)
     }
     else if (strnicmp(in_buffer, "#picture ", 9) == 0)
     {
-        uint16_t pic = 0;
+        unsigned int pic = 0;
         if (sscanf(in_buffer + 9, "%u", &pic) == 1)
         {
             os_show_bitmap(pic);
@@ -1810,7 +2411,7 @@ static bool check_hash(void)
     }
     else if (strnicmp(in_buffer, "#seed ", 6) == 0)
     {
-        uint16_t seed = 0;
+        unsigned int seed = 0;
         if (sscanf(in_buffer + 6, "%u", &seed) == 1)
         {
             const_seed = seed;
@@ -1820,6 +2421,34 @@ static bool check_hash(void)
         print_char('\r');
         return true;
     }
+#if USE_PROFILER
+    else if (strcmp_hash("#profile"))
+    {
+        putchar('\n');
+        print_profile();
+        return true;
+    }
+#endif
+#if USE_PAGE_DUMP
+    else if (strcmp_hash("#pages"))
+    {
+        putchar('\n');
+        print_page_allocation();
+        return true;
+    }
+#endif
+#if USE_UNDO
+    else if (strcmp_hash("#undo"))
+    {
+        unsigned int num_commands = 1;
+        if (in_buffer[5] == ' ')
+        {
+            sscanf(in_buffer + 6, "%u", &num_commands);
+        }
+        undo(num_commands);
+        return true;
+    }
+#endif
 
     return false;
 }
@@ -1849,8 +2478,11 @@ static bool corrupting_input(void)
     uint16_t d2;
     uint16_t abrev_word;
     uint16_t dict_addr;
+    uint8_t bucket;
 
     list9_ptr = list9_start_ptr;
+    // Must precede undo_snapshot() so the previous input's list9 writes are in the generation it saves.
+    mark_list9_blocks();
 
     if (in_buffer_ptr == NULL)
     {
@@ -1871,6 +2503,9 @@ static bool corrupting_input(void)
         {
             return false;
         }
+#if USE_UNDO
+        undo_snapshot();
+#endif
 
         /* check for invalid chars */
         for (uint8_t *iptr = in_buffer; *iptr != 0; iptr++)
@@ -1943,6 +2578,7 @@ static bool corrupting_input(void)
     if (d0 & 0x8000) // d0 < 0
     {
         dict_addr = def_dict;
+        bucket = 0;
         d1 = 0;
     }
     else
@@ -1964,20 +2600,21 @@ static bool corrupting_input(void)
             check_number();
             return true;
         }
+        bucket = (uint8_t) d1 + 1;
         a0 += d1 << 2;
         dict_addr = L9WORD(a0);
         d1 = L9WORD(a0 + 2);
     }
 
     /* ip13gotwordnumber */
-    init_unpack(dict_addr);
+    init_word_scan(bucket, dict_addr);
     /* ip14 */
     d1--;
 
     do
     {
         d1++;
-        if (unpack_word())
+        if (next_word())
         {
             /* ip21b */
             if (abrev_word == 0xffff) // -1
@@ -2066,6 +2703,202 @@ static bool is_dictionary_char(uint8_t c) __z88dk_fastcall
     return isupper(c) || isdigit(c);
 }
 
+static void get_vocabulary_entry(uint16_t index, vocabulary_entry_t *entry)
+{
+    memcpy(entry, effective_vocabulary(index * sizeof(vocabulary_entry_t)), sizeof(vocabulary_entry_t));
+}
+
+static void set_vocabulary_entry(uint16_t index, vocabulary_entry_t *entry)
+{
+    memcpy(effective_vocabulary(index * sizeof(vocabulary_entry_t)), entry, sizeof(vocabulary_entry_t));
+}
+
+static int8_t compare_vocabulary_entries(uint16_t index1, uint16_t index2)
+{
+    vocabulary_entry_t entry;
+    vocabulary_entry_t *entry2;
+    int result;
+
+    get_vocabulary_entry(index1, &entry);
+    entry2 = (vocabulary_entry_t *) effective_vocabulary(index2 * sizeof(vocabulary_entry_t));
+
+    result = strcmp(entry.key, entry2->key);
+    if (result != 0)
+    {
+        return (result < 0) ? -1 : 1;
+    }
+
+    return (entry.end < entry2->end) ? -1 : (entry.end > entry2->end);
+}
+
+static void swap_vocabulary_entries(uint16_t index1, uint16_t index2)
+{
+    vocabulary_entry_t entry1;
+    vocabulary_entry_t entry2;
+
+    get_vocabulary_entry(index1, &entry1);
+    get_vocabulary_entry(index2, &entry2);
+    set_vocabulary_entry(index1, &entry2);
+    set_vocabulary_entry(index2, &entry1);
+}
+
+static void sift_down_vocabulary_entry(uint16_t root, uint16_t size)
+{
+    while (true)
+    {
+        uint16_t child = (root << 1) + 1;
+
+        if (child >= size)
+        {
+            return;
+        }
+        if (child + 1 < size && compare_vocabulary_entries(child, child + 1) < 0)
+        {
+            child++;
+        }
+        if (compare_vocabulary_entries(root, child) >= 0)
+        {
+            return;
+        }
+
+        swap_vocabulary_entries(root, child);
+        root = child;
+    }
+}
+
+static void build_vocabulary_index_v2(void)
+{
+    vocabulary_entry_t entry;
+    uint16_t list0 = dict_data;
+
+    vocabulary_indexed = false;
+    vocabulary_size = 0;
+
+    while (is_dictionary_char(*effective(list0) & 0x7f))
+    {
+        uint8_t i = 0;
+        uint8_t x;
+
+        if (vocabulary_size == VOCABULARY_MAX_ENTRIES)
+        {
+            return;
+        }
+
+        memset(&entry, 0, sizeof(vocabulary_entry_t));
+        do
+        {
+            x = *effective(list0++);
+            if (i == VOCABULARY_KEY_SIZE - 1 || !is_dictionary_char(x & 0x7f))
+            {
+                return;
+            }
+            entry.key[i++] = tolower(x & 0x7f);
+        } while (x < 0x80);
+
+        entry.end = list0 - 1;
+        entry.code = *effective(list0++);
+        set_vocabulary_entry(vocabulary_size++, &entry);
+    }
+
+    /* heapsort */
+    for (uint16_t i = vocabulary_size >> 1; i > 0; i--)
+    {
+        sift_down_vocabulary_entry(i - 1, vocabulary_size);
+    }
+    for (uint16_t i = vocabulary_size; i > 1; i--)
+    {
+        swap_vocabulary_entries(0, i - 1);
+        sift_down_vocabulary_entry(0, i - 1);
+    }
+
+    vocabulary_indexed = true;
+}
+
+static uint16_t find_vocabulary_key(uint8_t *key) __z88dk_fastcall
+{
+    uint16_t low = 0;
+    uint16_t high = vocabulary_size;
+
+    while (low < high)
+    {
+        uint16_t mid = (low + high) >> 1;
+        if (strcmp(effective_vocabulary(mid * sizeof(vocabulary_entry_t)), key) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static uint8_t find_vocabulary_word(uint8_t *in_buf_ptr, uint16_t *end)
+{
+    /*
+     * Find the first dictionary word in dictionary order that either starts
+     * with the input word or is a proper prefix of it. The former is a match
+     * and the latter makes the dictionary walk continue in the next word.
+     */
+    uint8_t word[VOCABULARY_KEY_SIZE];
+    uint8_t length = 0;
+    uint8_t result = VOCABULARY_NOT_FOUND;
+    vocabulary_entry_t *entry;
+    uint16_t index;
+    bool longer;
+
+    *end = 0xFFFF;
+
+    while (in_buf_ptr[length] != 32 && length < VOCABULARY_KEY_SIZE - 1)
+    {
+        word[length] = tolower(in_buf_ptr[length]);
+        length++;
+    }
+    longer = (in_buf_ptr[length] != 32);
+
+    for (uint8_t i = 1; i < length + longer; i++)
+    {
+        uint8_t c = word[i];
+        word[i] = 0;
+        index = find_vocabulary_key(word);
+        if (index < vocabulary_size)
+        {
+            entry = (vocabulary_entry_t *) effective_vocabulary(index * sizeof(vocabulary_entry_t));
+            if (strcmp(entry->key, word) == 0 && entry->end < *end)
+            {
+                *end = entry->end;
+                result = VOCABULARY_PREFIX;
+            }
+        }
+        word[i] = c;
+    }
+
+    if (longer)
+    {
+        /* input word is longer than all dictionary words */
+        return result;
+    }
+
+    word[length] = 0;
+    for (index = find_vocabulary_key(word); index < vocabulary_size; index++)
+    {
+        entry = (vocabulary_entry_t *) effective_vocabulary(index * sizeof(vocabulary_entry_t));
+        if (strncmp(entry->key, word, length) != 0)
+        {
+            break;
+        }
+        if (entry->end < *end)
+        {
+            *end = entry->end;
+            result = VOCABULARY_FOUND;
+        }
+    }
+
+    return result;
+}
+
 static bool input_v2(uint16_t *word_count) __z88dk_fastcall
 {
     uint8_t a;
@@ -2073,7 +2906,7 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
     uint8_t *in_buf_ptr;
     uint8_t *out_buf_ptr;
     uint8_t *ptr;
-    uint8_t *list0_ptr;
+    uint16_t list0;
 
     /* flush */
     os_flush();
@@ -2092,6 +2925,9 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
     {
         return false;
     }
+#if USE_UNDO
+    undo_snapshot();
+#endif
 
     /* check for invalid chars */
     for (uint8_t *iptr = in_buffer; *iptr != 0; iptr++)
@@ -2114,7 +2950,7 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
     *word_count = 0;
     in_buf_ptr = in_buffer;
     out_buf_ptr = out_buffer;
-    list0_ptr = effective(dict_data);
+    list0 = dict_data;
 
     while (*in_buf_ptr == 32)
     {
@@ -2147,10 +2983,38 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
             ++in_buf_ptr;
         }
 
+        if (vocabulary_indexed && list0 == dict_data && *in_buf_ptr != 0)
+        {
+            uint16_t end;
+            uint8_t result = find_vocabulary_word(in_buf_ptr, &end);
+
+            if (result == VOCABULARY_PREFIX)
+            {
+                list0 = end + 3;
+            }
+            else
+            {
+                if (result == VOCABULARY_FOUND)
+                {
+                    *out_buf_ptr++ = *effective(end + 1);
+                }
+
+                while (*in_buf_ptr != 32)
+                {
+                    ++in_buf_ptr;
+                }
+                while (*in_buf_ptr == 32)
+                {
+                    ++in_buf_ptr;
+                }
+                continue;
+            }
+        }
+
         while (true)
         {
             a = *in_buf_ptr;
-            x = *list0_ptr++;
+            x = *effective(list0++);
 
             if (a == 32)
             {
@@ -2172,7 +3036,7 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
             {
                 while (x > 0 && x < 0x7f)
                 {
-                    x = *list0_ptr++;
+                    x = *effective(list0++);
                 }
 
                 if (x == 0)
@@ -2192,12 +3056,12 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
                         ++in_buf_ptr;
                     }
 
-                    list0_ptr = effective(dict_data);
+                    list0 = dict_data;
                     ptr = in_buf_ptr;
                 }
                 else
                 {
-                    list0_ptr++;
+                    list0++;
                     in_buf_ptr = ptr;
                 }
             }
@@ -2211,7 +3075,7 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
         if (a != 32)
         {
             in_buf_ptr = ptr;
-            list0_ptr += 2;
+            list0 += 2;
             continue;
         }
 
@@ -2220,10 +3084,10 @@ static bool input_v2(uint16_t *word_count) __z88dk_fastcall
             ++in_buf_ptr;
         }
 
-        --list0_ptr;
-        while (*list0_ptr++ < 0x7e);
-        *out_buf_ptr++ = *list0_ptr;
-        list0_ptr = effective(dict_data);
+        --list0;
+        while (*effective(list0++) < 0x7e);
+        *out_buf_ptr++ = *effective(list0);
+        list0 = dict_data;
     }
 }
 
@@ -2235,6 +3099,7 @@ static void input(void)
      */
     code_ptr--;
 
+    PROFILE_BEGIN(PROFILE_INPUT);
     if (game_type <= L9_V2)
     {
         uint16_t word_count;
@@ -2252,6 +3117,7 @@ static void input(void)
     {
         code_ptr += 5;
     }
+    PROFILE_END(PROFILE_INPUT);
 }
 
 static void var_con(void)
@@ -2741,6 +3607,7 @@ static void list_handler(void)
         {
             if (a4_in_ws)
             {
+                MARK_LIST_BLOCK(a4);
                 *(workspace.list_area + a4) = (uint8_t) val;
             }
             else
@@ -2818,6 +3685,7 @@ static void list_handler(void)
         {
             if (a4_in_ws)
             {
+                MARK_LIST_BLOCK(a4);
                 *(workspace.list_area + a4) = (uint8_t) val;
             }
             else
@@ -2894,6 +3762,7 @@ bool load_game(uint8_t *filename) __z88dk_fastcall
     clear_workspace();
     clear_stack();
     memset(workspace.list_area, 0, LIST_AREA_SIZE);
+    mark_all_blocks();
     return ret;
 }
 
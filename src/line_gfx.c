@@ -0,0 +1,918 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of line_gfx.h; a runtime renderer for the line-drawn pictures
+ * in the Level 9 V2/V3 games.
+ *
+ * The Level 9 graphics interpreter is based on the level9_gfx.c file of the
+ * convert_gfx tool and draws the pictures in the same way as that tool does.
+ * The pictures are drawn in their original resolution (160 or 320 x 128 or 96)
+ * directly on the column-major 320x256 layer 2 screen with a 14 pixel top
+ * margin. Pictures that are 160 pixels wide are widened by drawing each pixel
+ * as two pixels.
+ *
+ * The picture data is stored in up to 8 contiguous picture data pages and is
+ * paged-in, one page at a time, to MMU slot 0 when read. The table of graphics
+ * subroutine addresses, which is built when the picture data is loaded, and the
+ * stack of pixel spans used when filling an area are stored in the graphics
+ * work page, which is paged-in to MMU slot 1 when drawing a picture.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <arch/zxn/esxdos.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "zconfig.h"
+#include "line_gfx.h"
+#include "layer2.h"
+#include "memory_paging.h"
+#include "ide_friendly.h"
+
+#ifndef PICTURE_DATA_ADDRESS
+#define PICTURE_DATA_ADDRESS ((uint8_t *) 0x0000)
+#endif
+
+#ifndef GFX_SUB_TABLE_ADDRESS
+#define GFX_SUB_TABLE_ADDRESS ((uint16_t *) 0x2000)
+#endif
+
+#ifndef FILL_STACK_ADDRESS
+#define FILL_STACK_ADDRESS ((fill_span_t *) 0x3000)
+#endif
+
+#ifndef SCREEN_ADDRESS
+#define SCREEN_ADDRESS ((uint8_t *) 0x4000)
+#endif
+
+// The graphics subroutines start after the graphics type in the picture data.
+#define PICTURE_DATA_START 1
+
+#define GFX_STACK_SIZE 100
+
+// Number of graphics subroutines (0x000 - 0x7FF).
+#define NUM_GFX_SUBS 2048
+
+/*
+ * The fill stack gets the 4 KB of the graphics work page not used by the
+ * graphics subroutine table. In the worst case, a fill stacks up to three spans
+ * for each filled run of pixels and there can be pic_width / 2 runs per line,
+ * i.e. more than 40000 spans, which doesn't fit in the memory available. If the
+ * fill stack is full, the pixels of the span that can't be pushed are marked
+ * with FILL_MARK_COLOUR instead and the fill is completed by fill_marked_area().
+ */
+#define FILL_STACK_SIZE (0x1000 / sizeof(fill_span_t))
+
+// Palette index not used in the pictures for marking pixels still to be filled.
+#define FILL_MARK_COLOUR 4
+
+// Same picture top margin as used by the convert_gfx tool.
+#define PICTURE_TOP_MARGIN 14
+
+// Palette index for the unused parts of the screen, which is set to black.
+#define BACKGROUND_COLOR 255
+
+/*
+ * Graphics type    Resolution     Scale stack reset
+ * -------------------------------------------------
+ * GFX_V2           160 x 128            yes
+ * GFX_V3A          160 x 96             yes
+ * GFX_V3B          160 x 96             no
+ * GFX_V3C          320 x 96             no
+ */
+typedef enum gfx_type
+{
+    GFX_V2,
+    GFX_V3A,
+    GFX_V3B,
+    GFX_V3C
+} gfx_type_t;
+
+typedef struct fill_span
+{
+    int16_t x1;
+    int16_t x2;
+    uint8_t y;
+    int8_t dy;
+} fill_span_t;
+
+/*
+ * The Level 9 colour table (black, red, green, yellow, blue, brown, cyan and
+ * white) slightly changed to fit Spectrum Next better, in RGB333 format. Same
+ * colours as used by the convert_gfx tool.
+ */
+static const uint16_t colours[8] =
+{
+    0x0000, 0x00E0, 0x0138, 0x00FC, 0x0103, 0x008C, 0x011F, 0x01FF
+};
+
+static const uint16_t background_colour = 0x0000;
+
+// Size of the picture data file, 0 if no picture data is loaded.
+static uint16_t picture_data_size = 0;
+
+static gfx_type_t gfx_mode = GFX_V2;
+static uint16_t pic_width;
+static uint8_t pic_height;
+
+// Current picture data page in MMU slot 0.
+static uint8_t picture_data_page;
+
+// Base page of the layer 2 screen to draw on and its current page in MMU slot 2.
+static uint8_t screen_base_page;
+static uint8_t screen_page;
+
+static uint16_t palette[4] = { 0x0000, 0x0000, 0x0000, 0x0000 };
+
+static uint16_t gfx_a5;
+
+static uint8_t reflect_flag;
+static uint8_t scale;
+static uint8_t colour;
+static uint8_t option;
+
+// The drawing position may be far outside the picture, as in the convert_gfx tool.
+static int32_t draw_x;
+static int32_t draw_y;
+
+static uint16_t gfx_a5_stack[GFX_STACK_SIZE];
+static uint8_t gfx_a5_stack_pos;
+
+static uint8_t gfx_scale_stack[GFX_STACK_SIZE];
+static uint8_t gfx_scale_stack_pos;
+
+// Only the pixels having colour2 are set to colour1 when drawing and filling.
+static uint8_t colour1;
+static uint8_t colour2;
+
+// Range of lines with pixels marked with FILL_MARK_COLOUR (empty if top > bottom).
+static int16_t fill_mark_top;
+static int16_t fill_mark_bottom;
+
+/******************************************************************************
+ * Helper Functions
+ *****************************************************************************/
+
+static uint8_t read_byte(uint16_t offset) __z88dk_fastcall
+{
+    uint8_t page = picture_data_base_page + (uint8_t) (offset >> 13);
+
+    if (page != picture_data_page)
+    {
+        picture_data_page = page;
+        ZXN_WRITE_MMU0(page);
+    }
+
+    return PICTURE_DATA_ADDRESS[offset & 0x1FFF];
+}
+
+static uint8_t next_byte(void)
+{
+    return read_byte(gfx_a5++);
+}
+
+/*
+ * Build the table of graphics subroutine addresses in the same way as the
+ * convert_gfx tool. The address of a non-existent subroutine is 0.
+ */
+static void build_gfx_sub_table(void)
+{
+    uint8_t d3;
+    uint16_t d0;
+    uint16_t length;
+    uint16_t a5 = PICTURE_DATA_START;
+
+    memset(GFX_SUB_TABLE_ADDRESS, 0, NUM_GFX_SUBS * sizeof(uint16_t));
+
+    while (true)
+    {
+        d3 = read_byte(a5++);
+        if ((a5 >= picture_data_size) || (d3 & 0x80))
+        {
+            return;
+        }
+
+        d0 = (d3 << 4) | (read_byte(a5) >> 4);
+        if (GFX_SUB_TABLE_ADDRESS[d0] == 0)
+        {
+            GFX_SUB_TABLE_ADDRESS[d0] = a5 + 2;
+        }
+
+        d3 = read_byte(a5++) & 0x0F;
+        if (a5 >= picture_data_size)
+        {
+            return;
+        }
+
+        length = (d3 << 8) + read_byte(a5);
+        if ((length < 2) || (length - 2 >= picture_data_size - a5))
+        {
+            return;
+        }
+
+        a5 += length - 2;
+    }
+}
+
+/*
+ * Find the graphics subroutine with number d0 and return its address if found
+ * or 0 if not found.
+ */
+static uint16_t find_gfx_sub(uint16_t d0) __z88dk_fastcall
+{
+    return (d0 < NUM_GFX_SUBS) ? GFX_SUB_TABLE_ADDRESS[d0] : 0;
+}
+
+static void gosub_d0(uint16_t d0) __z88dk_fastcall
+{
+    uint16_t a5;
+
+    if (gfx_a5_stack_pos < GFX_STACK_SIZE)
+    {
+        a5 = find_gfx_sub(d0);
+        if (a5 != 0)
+        {
+            gfx_a5_stack[gfx_a5_stack_pos++] = gfx_a5;
+            gfx_scale_stack[gfx_scale_stack_pos++] = scale;
+            gfx_a5 = a5;
+        }
+    }
+}
+
+static int16_t scale_x(int32_t x) __z88dk_fastcall
+{
+    return (gfx_mode != GFX_V3C) ? (x >> 6) : (x >> 5);
+}
+
+static int16_t scale_y(int32_t y) __z88dk_fastcall
+{
+    return (gfx_mode == GFX_V2) ? 127 - (y >> 7) : 95 - (((y >> 5) + (y >> 6)) >> 3);
+}
+
+static void new_xy(int8_t x, int8_t y)
+{
+    if (reflect_flag & 2)
+    {
+        x = -x;
+    }
+
+    if (reflect_flag & 1)
+    {
+        y = -y;
+    }
+
+    draw_x += (x * scale) & ~7;
+    draw_y += (y * scale) & ~7;
+}
+
+/******************************************************************************
+ * Drawing Functions
+ *****************************************************************************/
+
+/*
+ * Return the address of the given picture pixel on the layer 2 screen and page
+ * in its layer 2 page to MMU slot 2. The pixel must be within the picture.
+ */
+static uint8_t *pixel_address(uint16_t x, uint8_t y)
+{
+    uint8_t page;
+
+    if (gfx_mode != GFX_V3C)
+    {
+        x <<= 1;
+    }
+
+    page = screen_base_page + (uint8_t) (x >> 5);
+    if (page != screen_page)
+    {
+        screen_page = page;
+        ZXN_WRITE_MMU2(page);
+    }
+
+    return SCREEN_ADDRESS + ((uint16_t) ((uint8_t) x & 0x1F) << 8) + (uint8_t) (PICTURE_TOP_MARGIN + y);
+}
+
+/*
+ * Set the given picture pixel to colour1 if it has colour2. Returns true if the
+ * pixel was set. The pixel must be within the picture.
+ */
+static bool set_pixel(uint16_t x, uint8_t y)
+{
+    uint8_t *pixel = pixel_address(x, y);
+
+    if (*pixel != colour2)
+    {
+        return false;
+    }
+
+    *pixel = colour1;
+    if (gfx_mode != GFX_V3C)
+    {
+        // The pixel to the right of the widened pixel is in the next column.
+        *(pixel + 0x100) = colour1;
+    }
+
+    return true;
+}
+
+static void plot(int16_t x, int16_t y)
+{
+    if (((uint16_t) x < pic_width) && ((uint16_t) y < pic_height))
+    {
+        set_pixel((uint16_t) x, (uint8_t) y);
+    }
+}
+
+/*
+ * Draw a line with the Bresenham algorithm, including both end points, in the
+ * same way as the convert_gfx tool.
+ */
+static void draw_line(int16_t x1, int16_t y1, int16_t x2, int16_t y2)
+{
+    int16_t dx = (x2 < x1) ? x1 - x2 : x2 - x1;
+    int16_t dy = (y2 < y1) ? y1 - y2 : y2 - y1;
+    int8_t x_add = (x2 < x1) ? -1 : 1;
+    int8_t y_add = (y2 < y1) ? -1 : 1;
+    int16_t err;
+    int16_t i;
+
+    if (dx > dy)
+    {
+        err = 2 * dy - dx;
+        for (i = dx; i != 0; i--)
+        {
+            plot(x1, y1);
+            if (err > 0)
+            {
+                y1 += y_add;
+                err += 2 * dy - 2 * dx;
+            }
+            else
+            {
+                err += 2 * dy;
+            }
+            x1 += x_add;
+        }
+    }
+    else
+    {
+        err = 2 * dx - dy;
+        for (i = dy; i != 0; i--)
+        {
+            plot(x1, y1);
+            if (err > 0)
+            {
+                x1 += x_add;
+                err += 2 * dx - 2 * dy;
+            }
+            else
+            {
+                err += 2 * dx;
+            }
+            y1 += y_add;
+        }
+    }
+
+    plot(x2, y2);
+}
+
+/*
+ * Set the given picture pixel to the given colour. The pixel must be within the
+ * picture.
+ */
+static void put_pixel(uint16_t x, uint8_t y, uint8_t pixel_colour)
+{
+    uint8_t *pixel = pixel_address(x, y);
+
+    *pixel = pixel_colour;
+    if (gfx_mode != GFX_V3C)
+    {
+        *(pixel + 0x100) = pixel_colour;
+    }
+}
+
+/*
+ * Return the colour of the given picture pixel or 255 if it is outside the
+ * picture.
+ */
+static uint8_t get_pixel(int16_t x, int16_t y)
+{
+    if (((uint16_t) x >= pic_width) || ((uint16_t) y >= pic_height))
+    {
+        return 255;
+    }
+
+    return *pixel_address((uint16_t) x, (uint8_t) y);
+}
+
+static void mark_fill_pixel(uint16_t x, uint8_t y)
+{
+    put_pixel(x, y, FILL_MARK_COLOUR);
+
+    if ((int16_t) y - 1 < fill_mark_top)
+    {
+        fill_mark_top = (y != 0) ? y - 1 : 0;
+    }
+    if ((int16_t) y + 1 > fill_mark_bottom)
+    {
+        fill_mark_bottom = (y + 1 < pic_height) ? y + 1 : y;
+    }
+}
+
+static void push_fill_span(uint16_t *sp, int16_t x1, int16_t x2, uint8_t y, int8_t dy)
+{
+    fill_span_t *span;
+
+    if ((uint8_t) (y + dy) >= pic_height)
+    {
+        return;
+    }
+
+    if (*sp < FILL_STACK_SIZE)
+    {
+        span = &FILL_STACK_ADDRESS[(*sp)++];
+        span->x1 = x1;
+        span->x2 = x2;
+        span->y = y;
+        span->dy = dy;
+    }
+    else
+    {
+        // The fill stack is full, mark the pixels of the span to be filled by
+        // fill_marked_area() instead.
+        y += dy;
+        for (; x1 <= x2; x1++)
+        {
+            if (*pixel_address((uint16_t) x1, y) == colour2)
+            {
+                mark_fill_pixel((uint16_t) x1, y);
+            }
+        }
+    }
+}
+
+/*
+ * Complete a fill whose stack has overflowed without using any stack. The
+ * marked pixels are spread to their 4-connected colour2 neighbours by repeated
+ * scans of the marked lines until nothing changes and are then set to colour1.
+ * This is much slower than the span fill but only needed for complex pictures.
+ */
+static void fill_marked_area(void)
+{
+    bool changed;
+    int16_t x;
+    int16_t y;
+
+    do
+    {
+        changed = false;
+
+        for (y = fill_mark_top; y <= fill_mark_bottom; y++)
+        {
+            for (x = 0; (uint16_t) x < pic_width; x++)
+            {
+                if ((get_pixel(x, y) == colour2) &&
+                    ((get_pixel(x - 1, y) == FILL_MARK_COLOUR) ||
+                     (get_pixel(x + 1, y) == FILL_MARK_COLOUR) ||
+                     (get_pixel(x, y - 1) == FILL_MARK_COLOUR) ||
+                     (get_pixel(x, y + 1) == FILL_MARK_COLOUR)))
+                {
+                    mark_fill_pixel((uint16_t) x, (uint8_t) y);
+                    changed = true;
+                }
+            }
+        }
+    }
+    while (changed);
+
+    for (y = fill_mark_top; y <= fill_mark_bottom; y++)
+    {
+        for (x = 0; (uint16_t) x < pic_width; x++)
+        {
+            if (get_pixel(x, y) == FILL_MARK_COLOUR)
+            {
+                put_pixel((uint16_t) x, (uint8_t) y, colour1);
+            }
+        }
+    }
+}
+
+/*
+ * Fill the 4-connected area of colour2 pixels containing the given point with
+ * colour1 using a scanline span fill in the same way as the convert_gfx tool.
+ * Each stacked span is a range of pixels on the line above or below an already
+ * filled span that should be examined.
+ */
+static void fill_area(int16_t x, int16_t y)
+{
+    uint16_t sp = 0;
+    fill_span_t *span;
+    int16_t x1;
+    int16_t x2;
+    int16_t left;
+    int8_t dy;
+
+    if (((uint16_t) x >= pic_width) || ((uint16_t) y >= pic_height) ||
+        (*pixel_address((uint16_t) x, (uint8_t) y) != colour2) || (colour1 == colour2))
+    {
+        return;
+    }
+
+    fill_mark_top = pic_height;
+    fill_mark_bottom = -1;
+
+    push_fill_span(&sp, x, x, (uint8_t) y, 1);
+    push_fill_span(&sp, x, x, (uint8_t) (y + 1), -1);
+
+    while (sp > 0)
+    {
+        span = &FILL_STACK_ADDRESS[--sp];
+        x1 = span->x1;
+        x2 = span->x2;
+        dy = span->dy;
+        y = span->y + dy;
+
+        // Extend the span to the left of x1.
+        for (x = x1; (x >= 0) && set_pixel((uint16_t) x, (uint8_t) y); x--);
+
+        if (x >= x1)
+        {
+            goto skip;
+        }
+
+        left = x + 1;
+        if (left < x1)
+        {
+            // Leak in the opposite direction to the left of the parent span.
+            push_fill_span(&sp, left, x1 - 1, (uint8_t) y, -dy);
+        }
+        x = x1 + 1;
+
+        do
+        {
+            for (; ((uint16_t) x < pic_width) && set_pixel((uint16_t) x, (uint8_t) y); x++);
+
+            push_fill_span(&sp, left, x - 1, (uint8_t) y, dy);
+            if (x > x2 + 1)
+            {
+                // Leak in the opposite direction to the right of the parent span.
+                push_fill_span(&sp, x2 + 1, x - 1, (uint8_t) y, -dy);
+            }
+skip:
+            for (x++; (x <= x2) && (*pixel_address((uint16_t) x, (uint8_t) y) != colour2); x++);
+            left = x;
+        }
+        while (x <= x2);
+    }
+
+    if (fill_mark_top <= fill_mark_bottom)
+    {
+        fill_marked_area();
+    }
+}
+
+/*
+ * Clear the picture with colour 0 and the rest of the layer 2 screen with the
+ * background colour.
+ */
+static void clear_picture(void)
+{
+    uint8_t *column;
+
+    for (uint16_t x = 0; x < 320; x++)
+    {
+        screen_page = screen_base_page + (uint8_t) (x >> 5);
+        ZXN_WRITE_MMU2(screen_page);
+        column = SCREEN_ADDRESS + ((uint16_t) ((uint8_t) x & 0x1F) << 8);
+
+        memset(column, BACKGROUND_COLOR, PICTURE_TOP_MARGIN);
+        memset(column + PICTURE_TOP_MARGIN, 0, pic_height);
+        memset(column + PICTURE_TOP_MARGIN + pic_height, BACKGROUND_COLOR, 256 - PICTURE_TOP_MARGIN - pic_height);
+    }
+}
+
+/******************************************************************************
+ * Graphics Instructions
+ *****************************************************************************/
+
+/* sdraw/smove instruction plus arguments are stored in an 8-bit word.
+ *     76543210
+ *     iixxxyyy
+ * where i is instruction code
+ *     x is x argument, high bit is sign
+ *     y is y argument, high bit is sign
+ */
+static void short_move(uint8_t d7, bool draw) __z88dk_callee
+{
+    int8_t x;
+    int8_t y;
+    int32_t x1 = draw_x;
+    int32_t y1 = draw_y;
+
+    x = (d7 & 0x18) >> 3;
+    if (d7 & 0x20)
+    {
+        x |= 0xFC;
+    }
+
+    y = (d7 & 0x03) << 2;
+    if (d7 & 0x04)
+    {
+        y |= 0xF0;
+    }
+
+    new_xy(x, y);
+
+    if (draw)
+    {
+        colour1 = colour & 3;
+        colour2 = option & 3;
+        draw_line(scale_x(x1), scale_y(y1), scale_x(draw_x), scale_y(draw_y));
+    }
+}
+
+/* draw/move instruction plus arguments are stored in a 16-bit word.
+ *     FEDCBA9876543210
+ *     iiiiixxxxxxyyyyy
+ * where i is instruction code
+ *     x is x argument, high bit is sign
+ *     y is y argument, high bit is sign
+ */
+static void long_move(uint8_t d7, bool draw) __z88dk_callee
+{
+    int8_t x;
+    int8_t y;
+    int32_t x1 = draw_x;
+    int32_t y1 = draw_y;
+    uint16_t xy = (d7 << 8) + next_byte();
+
+    x = (xy & 0x3E0) >> 5;
+    if (xy & 0x400)
+    {
+        x |= 0xE0;
+    }
+
+    y = (xy & 0x0F) << 2;
+    if (xy & 0x10)
+    {
+        y |= 0xC0;
+    }
+
+    new_xy(x, y);
+
+    if (draw)
+    {
+        colour1 = colour & 3;
+        colour2 = option & 3;
+        draw_line(scale_x(x1), scale_y(y1), scale_x(draw_x), scale_y(draw_y));
+    }
+}
+
+static void size(uint8_t d7) __z88dk_fastcall
+{
+    static const uint8_t size_table[7] = { 0x02, 0x04, 0x06, 0x07, 0x09, 0x0C, 0x10 };
+    uint16_t d0;
+
+    d7 &= 7;
+
+    if (d7)
+    {
+        d0 = (scale * size_table[d7 - 1]) >> 3;
+        scale = (d0 < 0x100) ? (uint8_t) d0 : 0xFF;
+    }
+    else
+    {
+        // size reset
+        scale = 0x80;
+        if ((gfx_mode == GFX_V2) || (gfx_mode == GFX_V3A))
+        {
+            gfx_scale_stack_pos = 0;
+        }
+    }
+}
+
+static void fill(uint8_t d7) __z88dk_fastcall
+{
+    // fill_a uses the current colour and fill_b the given colour.
+    colour1 = ((d7 & 7) == 0) ? (colour & 3) : (d7 & 3);
+    colour2 = option & 3;
+    fill_area(scale_x(draw_x), scale_y(draw_y));
+}
+
+static void reflect(uint8_t d7) __z88dk_fastcall
+{
+    if (d7 & 4)
+    {
+        d7 &= 3;
+        d7 ^= reflect_flag;
+    }
+
+    reflect_flag = d7;
+}
+
+static void change_colour(void)
+{
+    uint8_t d0 = next_byte();
+    palette[(d0 >> 3) & 3] = colours[d0 & 7];
+}
+
+static void amove(void)
+{
+    draw_x = 0x40 * next_byte();
+    draw_y = 0x40 * next_byte();
+}
+
+static void opt(void)
+{
+    uint8_t d0 = next_byte();
+    option = d0 ? ((d0 & 3) | 0x80) : 0;
+}
+
+static void restore_scale(void)
+{
+    if (gfx_scale_stack_pos > 0)
+    {
+        scale = gfx_scale_stack[gfx_scale_stack_pos - 1];
+    }
+}
+
+static bool rts(void)
+{
+    if (gfx_a5_stack_pos > 0)
+    {
+        gfx_a5 = gfx_a5_stack[--gfx_a5_stack_pos];
+
+        if (gfx_scale_stack_pos > 0)
+        {
+            scale = gfx_scale_stack[--gfx_scale_stack_pos];
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static bool run_instruction(void)
+{
+    uint8_t d7 = next_byte();
+
+    if ((d7 & 0xC0) != 0xC0)
+    {
+        switch (d7 >> 6)
+        {
+            case 0: short_move(d7, true); break;
+            case 1: short_move(d7, false); break;
+            case 2: gosub_d0(d7 & 0x3F); break;
+        }
+    }
+    else if ((d7 & 0x38) != 0x38)
+    {
+        switch ((d7 >> 3) & 7)
+        {
+            case 0: long_move(d7, true); break;
+            case 1: long_move(d7, false); break;
+            case 2: colour = d7 & 3; break;
+            case 3: size(d7); break;
+            case 4: fill(d7); break;
+            case 5: gosub_d0(((d7 & 7) << 8) + next_byte()); break;
+            case 6: reflect(d7); break;
+        }
+    }
+    else
+    {
+        switch (d7 & 7)
+        {
+            case 1: change_colour(); break;
+            case 3: amove(); break;
+            case 4: opt(); break;
+            case 5: restore_scale(); break;
+            case 7: return rts();
+            default: break; // Not implemented
+        }
+    }
+
+    return true;
+}
+
+static void run_gfx_sub(uint16_t a5) __z88dk_fastcall
+{
+    gfx_a5 = a5;
+    gfx_a5_stack_pos = 0;
+
+    if (gfx_a5 != 0)
+    {
+        while ((gfx_a5 < picture_data_size) && run_instruction());
+    }
+}
+
+/******************************************************************************
+ * Public Functions
+ *****************************************************************************/
+
+bool line_gfx_load(const char *filename) __z88dk_fastcall
+{
+    uint8_t filehandle;
+    struct esx_stat filestat;
+    uint16_t rest;
+
+    picture_data_size = 0;
+
+    errno = 0;
+    filehandle = esx_f_open(filename, ESX_MODE_OPEN_EXIST | ESX_MODE_R);
+    if (errno)
+    {
+        return false;
+    }
+
+    esx_f_fstat(filehandle, &filestat);
+    if (errno || (filestat.size <= PICTURE_DATA_START) || (filestat.size > 0xFFFF))
+    {
+        goto end;
+    }
+
+    // Load the picture data file via MMU slot 2 into the picture data pages.
+    rest = (uint16_t) filestat.size;
+    for (uint8_t page = picture_data_base_page; rest != 0; page++)
+    {
+        uint16_t chunk = (rest > 0x2000) ? 0x2000 : rest;
+        ZXN_WRITE_MMU2(page);
+        esx_f_read(filehandle, SCREEN_ADDRESS, chunk);
+        if (errno)
+        {
+            goto end;
+        }
+        rest -= chunk;
+    }
+
+    ZXN_WRITE_MMU2(picture_data_base_page);
+    gfx_mode = (gfx_type_t) (*SCREEN_ADDRESS & 0x03);
+    pic_width = (gfx_mode != GFX_V3C) ? 160 : 320;
+    pic_height = (gfx_mode == GFX_V2) ? 128 : 96;
+    picture_data_size = (uint16_t) filestat.size;
+
+end:
+    // Restore original page in MMU slot 2.
+    ZXN_WRITE_MMU2(10);
+    esx_f_close(filehandle);
+
+    if (picture_data_size != 0)
+    {
+        // Build the graphics subroutine table via MMU slots 0 and 1.
+        picture_data_page = 255;
+        ZXN_WRITE_MMU1(gfx_work_page);
+        build_gfx_sub_table();
+        page_in_rom();
+    }
+
+    return (picture_data_size != 0);
+}
+
+bool line_gfx_draw_picture(layer2_screen_t screen, layer2_palette_t layer2_palette, uint16_t pic)
+{
+    uint16_t pic_a5;
+
+    if (picture_data_size == 0)
+    {
+        return false;
+    }
+
+    // MMU slots 0 and 1 are currently used by the caller.
+    picture_data_page = 255;
+    ZXN_WRITE_MMU1(gfx_work_page);
+
+    pic_a5 = find_gfx_sub(pic);
+    if (pic_a5 == 0)
+    {
+        return false;
+    }
+
+    screen_base_page = ZXN_READ_REG(screen) << 1;
+    clear_picture();
+
+    reflect_flag = 0;
+    scale = 0x80;
+    colour = 3;
+    option = 0x80;
+    draw_x = 0x1400;
+    draw_y = 0x1400;
+    gfx_scale_stack_pos = 0;
+
+    // Reset the palette to black so that every picture is drawn independently
+    // of the previous one, in the same way as the convert_gfx tool does.
+    memset(palette, 0, sizeof(palette));
+
+    // Run graphics subroutine #0 and then the picture's graphics subroutine.
+    run_gfx_sub(find_gfx_sub(0));
+    run_gfx_sub(pic_a5);
+
+    layer2_set_palette(layer2_palette, palette, 4, 0);
+    layer2_set_palette(layer2_palette, &background_colour, 1, BACKGROUND_COLOR);
+
+    // Restore original page in MMU slot 2.
+    ZXN_WRITE_MMU2(10);
+    return true;
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Runtime renderer for the line-drawn pictures in the Level 9 V2/V3 games.
+ *
+ * The graphics subroutines of the game's graphics file are extracted by the
+ * convert_gfx tool to a picture data file, which is loaded into the picture
+ * data pages. The pictures are then drawn at runtime directly on the layer 2
+ * screen by the Level 9 graphics interpreter in this module, instead of being
+ * loaded as pre-converted NXI images.
+ *
+ * Note: MMU slots 0 and 1 are used when drawing a picture and MMU slot 2 is
+ * temporarily used when loading the picture data and writing to the layer 2
+ * screen.
+ ******************************************************************************/
+
+#ifndef _LINE_GFX_H
+#define _LINE_GFX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "layer2.h"
+#include "ide_friendly.h"
+
+// Picture data file created by the convert_gfx tool.
+#define PICTURE_DATA_FILE "gfx.dat"
+
+/*
+ * Load the given picture data file into the picture data pages. Returns true
+ * if successful. It is assumed that the ROM is paged in.
+ */
+bool line_gfx_load(const char *filename) __z88dk_fastcall;
+
+/*
+ * Draw the given picture on the given layer 2 screen and set its colours in the
+ * given layer 2 palette. Returns false, without touching the screen, if no
+ * picture data is loaded or if the picture doesn't exist. The game pages must
+ * be paged in again with page_in_game() afterwards.
+ */
+bool line_gfx_draw_picture(layer2_screen_t screen, layer2_palette_t palette, uint16_t pic);
+
+#endif
@@ -48,17 +48,40 @@
 #include "zconfig.h"
 #include "level9.h"
 #include "memory_paging.h"
+#include "page_allocator.h"
 #include "sprite.h"
 #include "layer2.h"
 #include "text_color.h"
 #include "mouse.h"
 #include "image_scroll.h"
+#include "interrupt_dispatcher.h"
+#include "profiler.h"
 #include "ide_friendly.h"
 
+#if USE_GFX && USE_LINE_GFX
+#include "line_gfx.h"
+#endif
+
+#if USE_TYPE_AHEAD
+#include "key_queue.h"
+#endif
+
+#if USE_ADAPTIVE_TURBO
+#include "turbo.h"
+#endif
+
+#if USE_IMAGE_CACHE
+#include "image_cache.h"
+#endif
+
 #if USE_IMAGE_SLIDESHOW
 #include "image_slideshow.h"
 #endif
 
+#if USE_TILEMAP_TEXT
+#include "tilemap_text.h"
+#endif
+
 #define VERSION "v1.0.0"
 
 #define SINGLE_GAME_FILE "gamedata.dat"
@@ -73,9 +96,19 @@
 #define OUT_BUFFER_SIZE 1152
 #define HISTORY_BUFFER_SIZE 128
 
+// The command history page is paged-in to MMU slot 0 when accessed.
+// The page starts with the prefix of the current history search followed by the
+// history entries as null-terminated strings, oldest entry first.
+#define HISTORY_PREFIX ((uint8_t *) 0x0000)
+#define HISTORY_ENTRIES ((uint8_t *) HISTORY_BUFFER_SIZE)
+#define HISTORY_ENTRIES_SIZE (0x2000 - HISTORY_BUFFER_SIZE)
+
 #define FD_STDIN 0
 #define FD_STDOUT 1
 
+// A 50 Hz video mode is assumed.
+#define MILLIS_PER_FRAME 20
+
 #define SCROLL_PROMPT_SPRITE_START_SLOT 0
 
 // Restart prompt message of the form:
@@ -92,7 +125,9 @@
 
 extern uint8_t tmp_buffer[256];
 
+#if !USE_TILEMAP_TEXT
 static struct fzx_font *out_term_font;
+#endif
 static uint16_t out_term_line_width;
 
 bool multiple_choice_game;
@@ -101,16 +136,29 @@ static uint8_t game_number = 1; // Only set for multiple choice games.
 /*
  * Note: When using the Timex hi-res mode, we use the free 2 KB RAM between the
  * two Timex hi-res screen buffers (0x5800 - 0x5FFF) for storing the 1152 bytes
- * out_buffer and the 128 bytes history_buffer and when using the ULA mode we
- * use the 1.25 KB RAM after the ULA screen buffer (0x5B00 - 0x5FFF) for this.
+ * out_buffer and the 128 bytes history_typed buffer and when using the ULA mode
+ * we use the 1.25 KB RAM after the ULA screen buffer (0x5B00 - 0x5FFF) for this.
  */
 
 static uint8_t *out_buffer = (uint8_t *) BUFFER_MEMORY_START;
 static uint16_t out_buffer_pos = 0;
 
-static uint8_t *history_buffer = (uint8_t *) (BUFFER_MEMORY_START + OUT_BUFFER_SIZE);
-uint16_t history_buffer_size = 0;
-bool edit_pressed = false;
+// The input typed when a history key was pressed (set by the input terminal).
+uint8_t *history_typed = (uint8_t *) (BUFFER_MEMORY_START + OUT_BUFFER_SIZE);
+uint16_t history_typed_size = 0;
+
+// The history key (EDIT, up or down) pressed or 0 (set by the input terminal).
+uint8_t history_key = 0;
+
+// Number of bytes used by the history entries.
+uint16_t history_size = 0;
+
+// Offset of the recalled history entry or history_size if none.
+static uint16_t history_pos = 0;
+
+static uint8_t history_page;
+
+static uint8_t history_saved_mmu0;
 
 #if USE_GFX
 bool gfx_on = false;
@@ -120,6 +168,20 @@ uint8_t max_image_height = 152;
 uint8_t gfx_window_height = 0;
 
 static uint8_t filename[MAX_PATH];
+
+// The game part whose image archive file is open (if available).
+static uint8_t image_archive_game_number = 0;
+static uint8_t image_archive;
+static bool image_archive_open = false;
+
+// True if a location image is being loaded into the layer 2 shadow screen.
+static bool image_loading = false;
+#endif
+
+#if USE_GFX && USE_LINE_GFX
+// The game part whose picture data file has been loaded (if available).
+static uint8_t picture_data_game_number = 0;
+static bool picture_data_loaded = false;
 #endif
 
 #if USE_GFX && USE_MOUSE
@@ -176,13 +238,41 @@ static void init_hardware(void)
 
     // Enable interrupts (initialized in interrupt.asm).
     intrinsic_ei();
+
+    // Share the frame interrupt between the interrupt handlers.
+    init_interrupt_dispatcher();
+
+    // Hand out the spare MMU pages and allocate the command history page. If
+    // there is no free page, history_page is 0 and the command history is off.
+    init_page_allocator();
+    history_page = alloc_pages(1, "History");
+
+#if USE_TYPE_AHEAD
+    // Start scanning the keyboard into the type-ahead keyboard queue.
+    init_key_queue();
+#endif
+
+#if USE_ADAPTIVE_TURBO
+    // Slow down the CPU when idle at the input prompt.
+    init_turbo();
+#endif
+
+#if USE_PROFILER
+    // Start measuring the time spent in the profiled sections.
+    init_profiler();
+#endif
 }
 
 static void wait_key(void)
 {
+#if USE_TYPE_AHEAD
+    key_queue_clear();
+    key_queue_get();
+#else
     in_wait_nokey();
     in_wait_key();
     in_wait_nokey();
+#endif
 }
 
 #if USE_GFX
@@ -206,12 +296,21 @@ static void show_title(void)
 static void init_out_terminal(void)
 {
     int fd;
+#if USE_TILEMAP_TEXT
+    struct r_Rect8 window;
+
+    // The line width of the tilemap output terminal is in characters.
+    fd = fileno(stdout);
+    ioctl(fd, IOCTL_OTERM_GET_WINDOW_RECT, &window);
+    out_term_line_width = window.width - 1;
+#else
     struct r_Rect16 paper;
 
     fd = fileno(stdout);
     out_term_font = (struct fzx_font *) ioctl(fd, IOCTL_OTERM_FONT, -1);
     ioctl(fd, IOCTL_OTERM_FZX_GET_PAPER_RECT, &paper);
     out_term_line_width = paper.width - ioctl(fd, IOCTL_OTERM_FZX_LEFT_MARGIN, -1) - 1;
+#endif
 }
 
 static void create_screen(void)
@@ -222,6 +321,11 @@ static void create_screen(void)
     // When graphics is enabled in os_graphics(), the clip window of the layer 2 screen
     // is set so that the ULA screen shows through and its text area is visible.
 
+#if USE_TILEMAP_TEXT
+    // Disable the ULA screen and display the text on the tilemap.
+    init_tilemap_text();
+#endif
+
 #if USE_TIMEX_HIRES
     // Clear the ULA screen in Timex hi-res mode.
     memset((void *) 0x4000, 0, 0x1800);
@@ -280,10 +384,38 @@ static bool is_multiple_choice_game(uint8_t *game_file) __z88dk_fastcall
     return (get_game_type() == L9_V3) && (strcmp(game_file, MULTI_GAME_FILE) == 0);
 }
 
+#if USE_TILEMAP_TEXT
+/*
+ * Return a pointer to the position in the given string where it should be
+ * broken on an even word boundary to fit the given line width in characters.
+ * Works like fzx_string_partition_ww() but for a fixed-width font.
+ */
+static uint8_t *str_partition_ww(uint8_t *str, uint16_t width)
+{
+    uint8_t *end = str;
+    uint8_t *last_space = NULL;
+
+    while (*end != '\0')
+    {
+        if (*end == ' ')
+        {
+            last_space = end;
+        }
+        if ((end - str) >= width)
+        {
+            return (last_space != NULL) ? last_space : end;
+        }
+        end++;
+    }
+
+    return end;
+}
+#endif
+
 /*
  * Word wrap the given string (i.e. replace space characters with newline
- * characters) so that it fits the width of the FZX output terminal on an
- * even word boundary. Any existing newline characters are respected.
+ * characters) so that it fits the width of the output terminal on an even
+ * word boundary. Any existing newline characters are respected.
  * The word wrapped string is returned.
  */
 static uint8_t *str_word_wrap(uint8_t *str, uint16_t str_len)
@@ -295,7 +427,11 @@ static uint8_t *str_word_wrap(uint8_t *str, uint16_t str_len)
 
     while (line != NULL)
     {
+#if USE_TILEMAP_TEXT
+        line_end = str_partition_ww(line, out_term_line_width);
+#else
         line_end = fzx_string_partition_ww(out_term_font, line, out_term_line_width);
+#endif
         if ((line_end - str) >= str_len)
         {
             break;
@@ -310,50 +446,163 @@ static uint8_t *str_word_wrap(uint8_t *str, uint16_t str_len)
     return str;
 }
 
+static void page_in_history(void)
+{
+    // The ROM may be paged-in to MMU slot 0, e.g. when reading a filename.
+    history_saved_mmu0 = ZXN_READ_REG(REG_MMU0);
+    ZXN_WRITE_MMU0(history_page);
+}
+
+static void page_out_history(void)
+{
+    ZXN_WRITE_MMU0(history_saved_mmu0);
+}
+
+static uint16_t previous_history_entry(uint16_t pos) __z88dk_fastcall
+{
+    // Skip the null-terminator of the previous entry and find its start.
+    pos--;
+    while ((pos != 0) && (HISTORY_ENTRIES[pos - 1] != '\0'))
+    {
+        pos--;
+    }
+
+    return pos;
+}
+
 // FIXME: Should be __z88dk_fastcall but it doesn't work here - compiler bug?
 static void save_history(uint8_t *input_in)
 {
     // Workaround: Manually transfer param to Z80 register.
     uint8_t *input = input_in;
-
-    if (input != NULL)
+    uint8_t *last_entry;
+    uint16_t length;
+    uint16_t first_length;
+    bool duplicate = false;
+
+    // The command history stays empty, and the history keys are therefore
+    // ignored, if no history page could be allocated.
+    if ((input != NULL) && (history_page != 0))
     {
-        // Copy entered input to history buffer.
-        history_buffer_size = strlen(input);
-        if (history_buffer_size > HISTORY_BUFFER_SIZE)
+        length = strlen(input);
+        if (length > HISTORY_BUFFER_SIZE - 1)
+        {
+            length = HISTORY_BUFFER_SIZE - 1;
+        }
+
+        page_in_history();
+
+        // Don't add the same input as the last entry again.
+        if (history_size != 0)
+        {
+            last_entry = HISTORY_ENTRIES + previous_history_entry(history_size);
+            duplicate = (strlen(last_entry) == length) && (memcmp(last_entry, input, length) == 0);
+        }
+
+        if (!duplicate)
         {
-            history_buffer_size = HISTORY_BUFFER_SIZE;
+            // Remove the oldest entries until there is room for the new entry.
+            while (history_size + length + 1 > HISTORY_ENTRIES_SIZE)
+            {
+                first_length = strlen(HISTORY_ENTRIES) + 1;
+                history_size -= first_length;
+                memmove(HISTORY_ENTRIES, HISTORY_ENTRIES + first_length, history_size);
+            }
+
+            memcpy(HISTORY_ENTRIES + history_size, input, length);
+            HISTORY_ENTRIES[history_size + length] = '\0';
+            history_size += length + 1;
         }
-        memcpy(history_buffer, input, history_buffer_size);
+
+        page_out_history();
     }
+
+    history_pos = history_size;
 }
 
 static void load_history(void)
 {
     b_array_t edit_buffer;
+    uint8_t *entry;
+    uint16_t pos;
+    uint16_t prefix_size;
 
-    // Copy history buffer to input terminal's edit buffer.
     fflush(stdin);
     ioctl(FD_STDIN, IOCTL_ITERM_GET_EDITBUF, &edit_buffer);
-    memcpy(edit_buffer.data, history_buffer, history_buffer_size);
-    edit_buffer.size = history_buffer_size;
+
+    page_in_history();
+
+    // If the input has been edited since the last recalled entry, start a new
+    // history search with the typed input as prefix.
+    entry = HISTORY_ENTRIES + history_pos;
+    if ((history_pos == history_size) || (strlen(entry) != history_typed_size) ||
+        (memcmp(entry, history_typed, history_typed_size) != 0))
+    {
+        memcpy(HISTORY_PREFIX, history_typed, history_typed_size);
+        HISTORY_PREFIX[history_typed_size] = '\0';
+        history_pos = history_size;
+    }
+
+    prefix_size = strlen(HISTORY_PREFIX);
+    pos = history_pos;
+
+    if (history_key == ASCII_CODE_DOWN)
+    {
+        // Find the next newer entry starting with the prefix or go back to the
+        // prefix itself if there is none.
+        while (pos != history_size)
+        {
+            pos += strlen(HISTORY_ENTRIES + pos) + 1;
+            if ((pos != history_size) && (strncmp(HISTORY_ENTRIES + pos, HISTORY_PREFIX, prefix_size) == 0))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        // Find the next older entry starting with the prefix. If there is none,
+        // the up key stays at the current entry while the EDIT key wraps around
+        // to the prefix itself.
+        do
+        {
+            if (pos == 0)
+            {
+                pos = (history_key == ASCII_CODE_UP) ? history_pos : history_size;
+                break;
+            }
+            pos = previous_history_entry(pos);
+        }
+        while (strncmp(HISTORY_ENTRIES + pos, HISTORY_PREFIX, prefix_size) != 0);
+    }
+
+    // Copy the found entry or the prefix to the input terminal's edit buffer.
+    history_pos = pos;
+    entry = (pos == history_size) ? HISTORY_PREFIX : HISTORY_ENTRIES + pos;
+    edit_buffer.size = strlen(entry);
+    memcpy(edit_buffer.data, entry, edit_buffer.size);
+
+    page_out_history();
+
     ioctl(FD_STDIN, IOCTL_ITERM_SET_EDITBUF, &edit_buffer);
+    history_key = 0;
 }
 
 static void read_filename(uint8_t *in_buf, uint16_t size)
 {
     uint16_t in_buf_pos = 0;
 
+    history_pos = history_size;
+
     while (true)
     {
         int c = getchar();
 
         // We have to support the EDIT key here to avoid havoc if it's pressed.
-        if ((c == EOF) && edit_pressed)
+        if ((c == EOF) && (history_key != 0))
         {
             clearerr(stdin);
             ioctl(FD_STDIN, IOCTL_RESET);
-            edit_pressed = false;
             load_history();
             in_buf_pos = 0;
             continue;
@@ -373,6 +622,51 @@ static void read_filename(uint8_t *in_buf, uint16_t size)
     }
 }
 
+#if USE_GFX
+static void flip_image(void)
+{
+    wait_video_line(max_image_height);
+    layer2_flip_main_shadow_screen();
+    layer2_flip_display_palettes();
+}
+
+/*
+ * Continue loading the location image being loaded, if any, by loading its
+ * next part or, if finish is true, all of its remaining parts. The image is
+ * displayed when it has been completely loaded.
+ */
+static void continue_image_load(bool finish) __z88dk_fastcall
+{
+    if (image_loading)
+    {
+        page_in_rom();
+        if (finish || !layer2_load_step())
+        {
+            image_loading = false;
+            if (layer2_load_end(true))
+            {
+                flip_image();
+            }
+        }
+        page_in_game();
+    }
+}
+
+/*
+ * Abandon loading the location image being loaded, if any.
+ */
+static void abandon_image_load(void)
+{
+    if (image_loading)
+    {
+        image_loading = false;
+        page_in_rom();
+        layer2_load_end(false);
+        page_in_game();
+    }
+}
+#endif
+
 static void clear_screen(void)
 {
 #if USE_GFX
@@ -381,9 +675,7 @@ static void clear_screen(void)
         uint16_t color = 0;
         layer2_set_palette(layer2_get_unused_access_palette(), &color, 1, 0);
         layer2_clear_screen(SHADOW_SCREEN, 0x00);
-        wait_video_line(max_image_height);
-        layer2_flip_main_shadow_screen();
-        layer2_flip_display_palettes();
+        flip_image();
     }
 #endif
 }
@@ -514,6 +806,8 @@ void os_print_char(uint8_t c) __z88dk_fastcall
 
 void os_flush(void)
 {
+    PROFILE_BEGIN(PROFILE_OS_FLUSH);
+
     if (out_buffer_pos != 0)
     {
         out_buffer[out_buffer_pos] = '\0';
@@ -521,6 +815,14 @@ void os_flush(void)
         fputs(out_buffer, stdout);
         out_buffer_pos = 0;
     }
+
+#if USE_GFX
+    // Load the next part of the location image being loaded, if any, while
+    // the game continues to produce output.
+    continue_image_load(false);
+#endif
+
+    PROFILE_END(PROFILE_OS_FLUSH);
 }
 
 bool os_input(uint8_t *in_buf, uint16_t size)
@@ -528,16 +830,22 @@ bool os_input(uint8_t *in_buf, uint16_t size)
     uint16_t in_buf_pos = 0;
 
     os_flush();
+#if USE_GFX
+    continue_image_load(true);
+#endif
+
+    PROFILE_BEGIN(PROFILE_OS_INPUT);
+
+    history_pos = history_size;
 
     while (true)
     {
         int c = getchar();
 
-        if ((c == EOF) && edit_pressed)
+        if ((c == EOF) && (history_key != 0))
         {
             clearerr(stdin);
             ioctl(FD_STDIN, IOCTL_RESET);
-            edit_pressed = false;
             load_history();
             in_buf_pos = 0;
             continue;
@@ -556,6 +864,8 @@ bool os_input(uint8_t *in_buf, uint16_t size)
         }
     }
 
+    PROFILE_END(PROFILE_OS_INPUT);
+
     if (in_buf_pos > 1)
     {
         save_history(in_buf);
@@ -564,9 +874,29 @@ bool os_input(uint8_t *in_buf, uint16_t size)
     return true;
 }
 
+#if !USE_TYPE_AHEAD
+static uint8_t inkey_wait(uint16_t frames) __z88dk_fastcall
+{
+    uint8_t key;
+    uint16_t wait_start = frame_count;
+
+    while ((key = in_inkey()) == 0)
+    {
+        if ((uint16_t) (frame_count - wait_start) >= frames)
+        {
+            break;
+        }
+        intrinsic_halt();
+    }
+
+    return key;
+}
+#endif
+
 uint8_t os_read_char(uint16_t millis) __z88dk_fastcall
 {
-    int c;
+    uint8_t c;
+    uint16_t frames;
 
     /*
      * The multiple choice games call os_read_char() to read the input choice.
@@ -585,15 +915,21 @@ uint8_t os_read_char(uint16_t millis) __z88dk_fastcall
         os_flush();
     }
 
-    c = in_inkey();
-    handle_special_key(c);
-    if (c || (millis == 0))
-    {
-        return c;
-    }
+#if USE_GFX
+    continue_image_load(true);
+#endif
 
-    in_pause(millis);
-    c = in_inkey();
+    /*
+     * Wait for the key in whole frames with the CPU halted between them. One
+     * frame is added to the wait since the current frame is already partly
+     * over, so that the wait is at least the given number of milliseconds.
+     */
+    frames = (millis == 0) ? 0 : millis / MILLIS_PER_FRAME + 1;
+#if USE_TYPE_AHEAD
+    c = key_queue_wait(frames);
+#else
+    c = inkey_wait(frames);
+#endif
     handle_special_key(c);
     return c;
 }
@@ -720,9 +1056,88 @@ void os_clear_graphics(void)
 #endif
 }
 
+#if USE_GFX && USE_LINE_GFX
+/*
+ * Load the picture data file of the current game part, if not already done.
+ * Returns true if the game has a picture data file. It is assumed that the ROM
+ * is paged in.
+ */
+static bool load_picture_data(void)
+{
+    if (picture_data_game_number != game_number)
+    {
+        picture_data_game_number = game_number;
+
+        if (multiple_choice_game)
+        {
+            sprintf(filename, "gfx/%u/" PICTURE_DATA_FILE, game_number);
+        }
+        else
+        {
+            strcpy(filename, "gfx/" PICTURE_DATA_FILE);
+        }
+
+        picture_data_loaded = line_gfx_load(filename);
+    }
+
+    return picture_data_loaded;
+}
+#endif
+
+#if USE_GFX
+/*
+ * Open the image archive file of the current game part, if not already done.
+ * The archive is kept open so that the images can be loaded without opening
+ * and closing a file for each image. Returns true if the game has an image
+ * archive file. It is assumed that the ROM is paged in.
+ */
+static bool open_image_archive(void)
+{
+    if (image_archive_game_number != game_number)
+    {
+        image_archive_game_number = game_number;
+
+        if (image_archive_open)
+        {
+#if USE_IMAGE_CACHE
+            image_cache_clear();
+#endif
+            esx_f_close(image_archive);
+        }
+
+        if (multiple_choice_game)
+        {
+            sprintf(filename, "gfx/%u/" IMAGE_ARCHIVE_FILE, game_number);
+        }
+        else
+        {
+            strcpy(filename, "gfx/" IMAGE_ARCHIVE_FILE);
+        }
+
+        errno = 0;
+        image_archive = esx_f_open(filename, ESX_MODE_R | ESX_MODE_OPEN_EXIST);
+        image_archive_open = (errno == 0);
+
+#if USE_IMAGE_CACHE
+        // Load as much of the image archive as fits into RAM, if there is
+        // spare RAM for it, so that its images are loaded without disk access.
+        if (image_archive_open)
+        {
+            image_cache_fill(image_archive);
+        }
+#endif
+    }
+
+    return image_archive_open;
+}
+#endif
+
 void os_show_bitmap(uint16_t pic) __z88dk_fastcall
 {
 #if USE_GFX
+    // Abandon loading any previous image that hasn't been displayed yet.
+    abandon_image_load();
+
     // Some of the V3 games (Colossal Adventure and Adventure Quest) use the
     // non-existent image #0 for showing a black picture when the room is dark.
     if (pic == 0)
@@ -735,28 +1150,44 @@ void os_show_bitmap(uint16_t pic) __z88dk_fastcall
     // when switching to a new image, the new image and its palette is first
     // loaded into the layer 2 shadow screen and the layer 2 palette (primary or
     // secondary) not currently used. Then the layer 2 main/shadow screen and
-    // the primary/secondary palettes are flipped to show the new image.
+    // the primary/secondary palettes are flipped to show the new image. If the
+    // game has an image archive file, the image is loaded from it instead of
+    // from its own NXI image file. The image is loaded incrementally, one part
+    // at a time in os_flush(), so that the game can print the location text
+    // while the image is being loaded. The rest of the image is loaded and the
+    // image displayed when the game waits for input. If the game has a picture
+    // data file, the line-drawn image is instead drawn at once at runtime.
+    // Image loading problems are not reported since some Level 9 games
+    // sometimes issue loading of non-existent images and expect silent failure.
 
-    if (multiple_choice_game)
+    page_in_rom();
+
+#if USE_LINE_GFX
+    if (load_picture_data())
     {
-        sprintf(filename, "gfx/%u/%u.nxi", game_number, pic);
+        if (line_gfx_draw_picture(SHADOW_SCREEN, layer2_get_unused_access_palette(), pic))
+        {
+            flip_image();
+        }
     }
     else
+#endif
+    if (open_image_archive())
     {
-        sprintf(filename, "gfx/%u.nxi", pic);
+        image_loading = layer2_load_archive_begin(SHADOW_SCREEN, layer2_get_unused_access_palette(), image_archive, pic, tmp_buffer);
     }
-
-    errno = 0;
-    page_in_rom();
-
-    layer2_load_screen(SHADOW_SCREEN, layer2_get_unused_access_palette(), filename, tmp_buffer);
-    // Skip reporting image loading problems since some Level 9 games sometimes
-    // issue loading of non-existent images and expect silent failure.
-    if (!errno)
+    else
     {
-        wait_video_line(max_image_height);
-        layer2_flip_main_shadow_screen();
-        layer2_flip_display_palettes();
+        if (multiple_choice_game)
+        {
+            sprintf(filename, "gfx/%u/%u.nxi", game_number, pic);
+        }
+        else
+        {
+            sprintf(filename, "gfx/%u.nxi", pic);
+        }
+
+        image_loading = layer2_load_begin(SHADOW_SCREEN, layer2_get_unused_access_palette(), filename, tmp_buffer);
     }
 
     page_in_game();
@@ -794,6 +1225,9 @@ void os_fatal_error(uint8_t *format, ...)
 int main(void)
 {
     uint8_t *game_file;
+#if USE_PROFILER
+    bool running;
+#endif
 
     init_hardware();
 
@@ -824,6 +1258,14 @@ int main(void)
     get_picture_size(NULL, &max_image_height);
 #endif
 
+#if USE_IMAGE_CACHE
+    // Open the image archive and cache it at startup instead of when the
+    // first image is shown.
+    page_in_rom();
+    open_image_archive();
+    page_in_game();
+#endif
+
 #if USE_IMAGE_SLIDESHOW
     run_image_slideshow();
 #endif
@@ -831,13 +1273,27 @@ int main(void)
 #if USE_GFX
     // Make sure that graphics is enabled (Snowball) and the
     // start location image is displayed immediately (Knight Orc).
-    // Image #1 is the start location image in V4 games and a
-    // non-existent image in V2/V3 games (with a silent failure).
+    // Image #1 is the start location image in V4 games. In V2/V3
+    // games, it's not a location image but may be a sub-image of
+    // the line-drawn location images.
     os_graphics(true);
-    os_show_bitmap(1);
+    if (get_game_type() == L9_V4)
+    {
+        os_show_bitmap(1);
+    }
 #endif
 
+#if USE_PROFILER
+    do
+    {
+        PROFILE_BEGIN(PROFILE_RUN_GAME);
+        for (uint16_t i = 0; (i < PROFILE_RUN_GAME_BATCH) && (running = run_game()); i++);
+        PROFILE_END(PROFILE_RUN_GAME);
+    }
+    while (running);
+#else
     while (run_game());
+#endif
 
     return 0;
 }
@@ -10,6 +10,8 @@ PUBLIC _page_in_rom
 PUBLIC _page_in_game
 PUBLIC _effective
 PUBLIC _effective_ram_save
+PUBLIC _effective_undo
+PUBLIC _effective_vocabulary
 
 defc MEMORY_BASE_PAGE = 40
 defc RAM_SAVE_BASE_PAGE = 36
@@ -162,6 +164,107 @@ effective_ram_save_end:
     ex de,hl
     ret
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; _EFFECTIVE_UNDO
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_effective_undo:
+
+   ; uint8_t *effective_undo(uint16_t offset) __z88dk_fastcall;
+   ;
+   ; enter : hl = offset in undo ring
+   ; exit  : hl = effective pointer
+   ; uses  : af, de, hl
+
+    ex de,hl                   ; de = offset
+
+; uint8_t page = (uint8_t) (offset / 0x2000);
+    ld a,d
+    rlca
+    rlca
+    rlca
+    and a,0x07                 ; a = page
+
+; uint8_t new_page = undo_base_page + 1 + page;
+    ld hl,_undo_base_page
+    add a,(hl)
+    inc a
+    ld h,a                     ; h = new_page
+
+; uint16_t addr = offset % 0x2000;
+    ld a,d
+    and a,0x1F
+    ld d,a                     ; de = addr
+
+; if (current_page != new_page)
+    ld a,(_current_page)
+    cp a,h
+    jr z,effective_undo_end
+; current_page = new_page;
+    ld a,h
+    ld (_current_page),a
+; ZXN_WRITE_MMU0(current_page);
+    mmu0 a
+; ZXN_WRITE_MMU1(current_page + 1);
+    inc a
+    mmu1 a
+; end-if
+
+effective_undo_end:
+; return (uint8_t *) addr;
+    ex de,hl
+    ret
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; _EFFECTIVE_VOCABULARY
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+_effective_vocabulary:
+
+   ; uint8_t *effective_vocabulary(uint16_t offset) __z88dk_fastcall;
+   ;
+   ; enter : hl = offset in vocabulary index
+   ; exit  : hl = effective pointer
+   ; uses  : af, de, hl
+
+    ex de,hl                   ; de = offset
+
+; uint8_t page = (uint8_t) (offset / 0x2000);
+    ld a,d
+    rlca
+    rlca
+    rlca
+    and a,0x07                 ; a = page
+
+; uint8_t new_page = vocabulary_base_page + page;
+    ld hl,_vocabulary_base_page
+    add a,(hl)
+    ld h,a                     ; h = new_page
+
+; uint16_t addr = offset % 0x2000;
+    ld a,d
+    and a,0x1F
+    ld d,a                     ; de = addr
+
+; if (current_page != new_page)
+    ld a,(_current_page)
+    cp a,h
+    jr z,effective_vocabulary_end
+; current_page = new_page;
+    ld a,h
+    ld (_current_page),a
+; ZXN_WRITE_MMU0(current_page);
+    mmu0 a
+; ZXN_WRITE_MMU1(current_page + 1);
+    inc a
+    mmu1 a
+; end-if
+
+effective_vocabulary_end:
+; return (uint8_t *) addr;
+    ex de,hl
+    ret
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ;; DATA
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -169,6 +272,24 @@ effective_ram_save_end:
 SECTION data_user
 
 PUBLIC _current_page
+PUBLIC _undo_base_page
+PUBLIC _picture_data_base_page
+PUBLIC _gfx_work_page
+PUBLIC _vocabulary_base_page
 
 _current_page:
    DEFB 0
+
+; First pages of the memory areas allocated by init_page_allocator().
+
+_undo_base_page:
+   DEFB 0
+
+_picture_data_base_page:
+   DEFB 0
+
+_gfx_work_page:
+   DEFB 0
+
+_vocabulary_base_page:
+   DEFB 0
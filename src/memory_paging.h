@@ -18,11 +18,37 @@
 #define RAM_SAVE_BASE_PAGE 36
 #define NUM_RAM_SAVE_PAGES 4
 
+// The memory areas below are allocated from the free pool by the page allocator
+// (see page_allocator.h) and their first pages are kept in the global variables
+// declared below.
+
+// The 32 KB undo area (current snapshot page followed by a ring of deltas).
+#define NUM_UNDO_PAGES 4
+
+// The 64 KB picture data area for the line-drawn pictures (if USE_LINE_GFX is enabled).
+#define NUM_PICTURE_DATA_PAGES 8
+
+// The 8 KB work area (graphics subroutine table and fill stack) used when drawing
+// the line-drawn pictures.
+#define NUM_GFX_WORK_PAGES 1
+
+// The 32 KB vocabulary index with the pre-decoded (V3/V4) or sorted (V2) dictionary words.
+#define NUM_VOCABULARY_PAGES 4
+
 /*
  * Current page in MMU slot 0.
  */
 extern uint8_t current_page;
 
+/*
+ * First pages of the undo area, the picture data area, the graphics work area
+ * and the vocabulary index (set by init_page_allocator()).
+ */
+extern uint8_t undo_base_page;
+extern uint8_t picture_data_base_page;
+extern uint8_t gfx_work_page;
+extern uint8_t vocabulary_base_page;
+
 /*
  * Page in the ROM to MMU slots 0 and 1.
  */
@@ -49,4 +75,21 @@ uint8_t *effective(uint16_t ptr) __preserves_regs(b,c) __z88dk_fastcall;
  */
 uint8_t *effective_ram_save(uint8_t slot) __preserves_regs(b,c) __z88dk_fastcall;
 
+/*
+ * Convert the given offset in the undo ring to an effective pointer.
+ * The returned pointer will point into an undo ring page in MMU slot 0 with the
+ * next undo ring page in MMU slot 1 and update the current_page global variable
+ * to the undo ring page in MMU slot 0. The undo ring starts at the page after
+ * undo_base_page.
+ */
+uint8_t *effective_undo(uint16_t offset) __preserves_regs(b,c) __z88dk_fastcall;
+
+/*
+ * Convert the given offset in the vocabulary index to an effective pointer.
+ * The returned pointer will point into a vocabulary index page in MMU slot 0
+ * with the next vocabulary index page in MMU slot 1 and update the current_page
+ * global variable to the vocabulary index page in MMU slot 0.
+ */
+uint8_t *effective_vocabulary(uint16_t offset) __preserves_regs(b,c) __z88dk_fastcall;
+
 #endif
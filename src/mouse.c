@@ -4,18 +4,17 @@
  * Implementation of mouse.h; a C API for PS/2 Kempston mouse support.
  *
  * This module queries the mouse state from the mouse driver each 1/50th second
- * in an IM2 ISR. The module then updates the mouse pointer using a hardware
- * sprite and invokes a user-supplied mouse listener. The mouse pointer is
- * hidden if the mouse is not moved for a while.
+ * in an interrupt handler of the interrupt dispatcher. The module then updates
+ * the mouse pointer using a hardware sprite and invokes a user-supplied mouse
+ * listener. The mouse pointer is hidden if the mouse is not moved for a while.
  ******************************************************************************/
 
-#include <z80.h>
-#include <intrinsic.h>
 #include <input.h>
 #include <stdint.h>
 
 #include "mouse.h"
 #include "sprite.h"
+#include "interrupt_dispatcher.h"
 #include "ide_friendly.h"
 
 #define MOUSE_SPRITE_SLOT 63
@@ -43,7 +42,7 @@ static MOUSE_LISTENER user_mouse_listener;
  * be moved less than half a rotation between two readings.
  ******************************************************************************/
 
-IM2_DEFINE_ISR(mouse_handler)
+static void mouse_interrupt_handler(void)
 {
     uint16_t last_mouse_x = mouse_x;
     uint16_t last_mouse_y = mouse_y;
@@ -107,9 +106,6 @@ void init_mouse(const void *mouse_sprite_buf, MOUSE_LISTENER mouse_listener)
     in_mouse_kempston_init();
     in_mouse_kempston_setpos(0, 0);
 
-    // Install mouse handler interrupt service routine.
-    intrinsic_di();
-    z80_bpoke(0xFDFD, 0xC3); // jp
-    z80_wpoke(0xFDFE, (uint16_t) mouse_handler);
-    intrinsic_ei();
+    // Update the mouse pointer each frame.
+    add_interrupt_handler(mouse_interrupt_handler, 1);
 }
@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of page_allocator.h.
+ *
+ * The allocated blocks of pages are kept in an array sorted by first page. A
+ * new block is allocated at the start of the first large enough gap between the
+ * allocated blocks.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "zconfig.h"
+#include "page_allocator.h"
+#include "memory_paging.h"
+#include "ide_friendly.h"
+
+#define MMU0_ADDRESS ((volatile uint8_t *) 0x0000)
+
+typedef struct page_block
+{
+    uint8_t first_page;
+    uint8_t num_pages;
+    const char *owner;
+} page_block_t;
+
+static page_block_t blocks[MAX_PAGE_BLOCKS];
+
+static uint8_t num_blocks = 0;
+
+static uint8_t num_pages = NUM_PAGES_1MB;
+
+static bool is_2mb_ram(void)
+{
+    uint8_t saved_mmu0 = ZXN_READ_REG(REG_MMU0);
+    uint8_t saved_1mb_byte;
+    uint8_t saved_2mb_byte;
+    bool found;
+
+    // On an unexpanded Spectrum Next, the top 2 MB page mirrors page 95 or
+    // doesn't exist at all. The probed bytes are restored afterwards.
+    ZXN_WRITE_MMU0(NUM_PAGES_1MB - 1);
+    saved_1mb_byte = *MMU0_ADDRESS;
+    *MMU0_ADDRESS = 0x55;
+    ZXN_WRITE_MMU0(NUM_PAGES_2MB - 1);
+    saved_2mb_byte = *MMU0_ADDRESS;
+    *MMU0_ADDRESS = 0xAA;
+    found = (*MMU0_ADDRESS == 0xAA);
+    ZXN_WRITE_MMU0(NUM_PAGES_1MB - 1);
+    found = found && (*MMU0_ADDRESS == 0x55);
+
+    // Only restore the top 2 MB page if it exists on its own. Page 95 is
+    // restored last since the top 2 MB page may mirror it.
+    if (found)
+    {
+        ZXN_WRITE_MMU0(NUM_PAGES_2MB - 1);
+        *MMU0_ADDRESS = saved_2mb_byte;
+        ZXN_WRITE_MMU0(NUM_PAGES_1MB - 1);
+    }
+    *MMU0_ADDRESS = saved_1mb_byte;
+
+    ZXN_WRITE_MMU0(saved_mmu0);
+    return found;
+}
+
+static bool insert_block(uint8_t index, uint8_t first_page, uint8_t num_pages_in, const char *owner)
+{
+    if (num_blocks == MAX_PAGE_BLOCKS)
+    {
+        return false;
+    }
+
+    for (uint8_t i = num_blocks; i > index; i--)
+    {
+        blocks[i] = blocks[i - 1];
+    }
+
+    blocks[index].first_page = first_page;
+    blocks[index].num_pages = num_pages_in;
+    blocks[index].owner = owner;
+    num_blocks++;
+    return true;
+}
+
+void init_page_allocator(void)
+{
+    num_blocks = 0;
+    num_pages = is_2mb_ram() ? NUM_PAGES_2MB : NUM_PAGES_1MB;
+
+    // Allocate the interpreter's own memory areas first. They take at most 17
+    // pages of the initially empty free pool, so these allocations can't fail.
+#if USE_UNDO
+    undo_base_page = alloc_pages(NUM_UNDO_PAGES, "Undo");
+#endif
+#if USE_GFX && USE_LINE_GFX
+    picture_data_base_page = alloc_pages(NUM_PICTURE_DATA_PAGES, "Picture data");
+    gfx_work_page = alloc_pages(NUM_GFX_WORK_PAGES, "Graphics work");
+#endif
+    vocabulary_base_page = alloc_pages(NUM_VOCABULARY_PAGES, "Vocabulary");
+}
+
+uint8_t get_num_pages(void)
+{
+    return num_pages;
+}
+
+uint8_t alloc_pages(uint8_t num_pages_in, const char *owner)
+{
+    uint8_t free_page = FIRST_FREE_PAGE;
+    uint8_t i;
+
+    for (i = 0; i < num_blocks; i++)
+    {
+        if (blocks[i].first_page - free_page >= num_pages_in)
+        {
+            break;
+        }
+        free_page = blocks[i].first_page + blocks[i].num_pages;
+    }
+
+    if ((i == num_blocks) && (num_pages - free_page < num_pages_in))
+    {
+        return 0;
+    }
+
+    return insert_block(i, free_page, num_pages_in, owner) ? free_page : 0;
+}
+
+void free_pages(uint8_t first_page) __z88dk_fastcall
+{
+    for (uint8_t i = 0; i < num_blocks; i++)
+    {
+        if (blocks[i].first_page == first_page)
+        {
+            num_blocks--;
+            for (; i < num_blocks; i++)
+            {
+                blocks[i] = blocks[i + 1];
+            }
+            break;
+        }
+    }
+}
+
+uint8_t get_max_free_pages(void)
+{
+    uint8_t free_page = FIRST_FREE_PAGE;
+    uint8_t max_free_pages = 0;
+
+    for (uint8_t i = 0; i <= num_blocks; i++)
+    {
+        uint8_t end_page = (i < num_blocks) ? blocks[i].first_page : num_pages;
+
+        if (end_page - free_page > max_free_pages)
+        {
+            max_free_pages = end_page - free_page;
+        }
+        if (i < num_blocks)
+        {
+            free_page = blocks[i].first_page + blocks[i].num_pages;
+        }
+    }
+
+    return max_free_pages;
+}
+
+void print_page_allocation(void)
+{
+    uint8_t free_page = FIRST_FREE_PAGE;
+
+    printf("Pages %u - %u:\n", FIRST_FREE_PAGE, num_pages - 1);
+
+    for (uint8_t i = 0; i <= num_blocks; i++)
+    {
+        uint8_t end_page = (i < num_blocks) ? blocks[i].first_page : num_pages;
+
+        if (end_page > free_page)
+        {
+            printf("%u - %u: <free>\n", free_page, end_page - 1);
+        }
+        if (i < num_blocks)
+        {
+            free_page = blocks[i].first_page + blocks[i].num_pages;
+            printf("%u - %u: %s\n", blocks[i].first_page, free_page - 1, blocks[i].owner);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Allocator for the spare 8 KB MMU pages.
+ *
+ * The MMU pages below FIRST_FREE_PAGE have fixed usages (see memory_map.txt).
+ * The pages from FIRST_FREE_PAGE up to the top of the installed RAM (page 95 on
+ * an unexpanded Spectrum Next and page 223 on a Spectrum Next with 2 MB RAM)
+ * form the free pool, from which caches, indexes etc. can allocate contiguous
+ * blocks of pages. Each allocated block is tagged with the name of its owner.
+ *
+ * The interpreter's own memory areas in the free pool (the undo area, the
+ * picture data and graphics work areas and the vocabulary index) are allocated
+ * when the page allocator is initialized and their first pages are stored in
+ * the variables declared in memory_paging.h.
+ ******************************************************************************/
+
+#ifndef _PAGE_ALLOCATOR_H
+#define _PAGE_ALLOCATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ide_friendly.h"
+
+// First page of the free pool.
+#define FIRST_FREE_PAGE 48
+
+// Number of pages on an unexpanded Spectrum Next (1 MB RAM) and on a Spectrum
+// Next with 2 MB RAM.
+#define NUM_PAGES_1MB 96
+#define NUM_PAGES_2MB 224
+
+// Max number of allocated blocks of pages.
+#define MAX_PAGE_BLOCKS 16
+
+/*
+ * Initialize the page allocator. Detects the amount of installed RAM and
+ * allocates the interpreter's own memory areas in the free pool.
+ */
+void init_page_allocator(void);
+
+/*
+ * Return the number of pages of the installed RAM, i.e. NUM_PAGES_1MB or
+ * NUM_PAGES_2MB.
+ */
+uint8_t get_num_pages(void);
+
+/*
+ * Allocate a contiguous block of the given number of pages for the given owner.
+ * Returns the first page of the block or 0 if there is no such free block.
+ */
+uint8_t alloc_pages(uint8_t num_pages, const char *owner);
+
+/*
+ * Free the block of pages starting at the given page.
+ */
+void free_pages(uint8_t first_page) __z88dk_fastcall;
+
+/*
+ * Return the number of pages in the largest contiguous free block.
+ */
+uint8_t get_max_free_pages(void);
+
+/*
+ * Print the owner of each block of pages in the free pool (debug dump).
+ */
+void print_page_allocation(void);
+
+#endif
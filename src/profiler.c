@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of profiler.h.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "zconfig.h"
+#include "profiler.h"
+#include "raster_time.h"
+#include "ide_friendly.h"
+
+#if USE_ADAPTIVE_TURBO
+#include "turbo.h"
+#endif
+
+typedef struct section_stats
+{
+    uint32_t start;
+    uint32_t calls;
+    uint32_t total;
+} section_stats_t;
+
+static const char *section_names[PROFILE_NUM_SECTIONS] =
+{
+    "Run game",
+    "Input",
+    "OS input",
+    "Print message",
+    "OS flush",
+    "Image load"
+};
+
+static section_stats_t stats[PROFILE_NUM_SECTIONS];
+
+static uint32_t init_time;
+
+static uint32_t lines_to_ms(uint32_t lines) __z88dk_fastcall
+{
+    // One raster line is 64 us, divide first to avoid overflow.
+    return (lines / 125) * 8 + ((lines % 125) * 8) / 125;
+}
+
+void init_profiler(void)
+{
+    init_raster_time();
+    init_time = get_raster_time();
+}
+
+void profile_begin(uint8_t section) __z88dk_fastcall
+{
+    stats[section].start = get_raster_time();
+}
+
+void profile_end(uint8_t section) __z88dk_fastcall
+{
+    section_stats_t *section_stats = &stats[section];
+
+    section_stats->total += get_raster_time() - section_stats->start;
+    section_stats->calls++;
+}
+
+void print_profile(void)
+{
+    printf("Profile of %lu ms\n", lines_to_ms(get_raster_time() - init_time));
+    printf("Section: calls, total ms\n");
+
+    for (uint8_t i = 0; i < PROFILE_NUM_SECTIONS; i++)
+    {
+        printf("%s: %lu, %lu\n", section_names[i], stats[i].calls, lines_to_ms(stats[i].total));
+    }
+
+#if USE_ADAPTIVE_TURBO
+    {
+        uint32_t fast_frames;
+        uint32_t slow_frames;
+
+        // One frame is 20 ms.
+        get_turbo_frames(&fast_frames, &slow_frames);
+        printf("28 MHz: %lu ms\n", fast_frames * 20);
+        printf("3.5 MHz: %lu ms\n", slow_frames * 20);
+    }
+#endif
+}
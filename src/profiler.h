@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Lightweight profiler for finding out where the time of a game turn is spent.
+ * Only compiled if USE_PROFILER = 1.
+ *
+ * The code to be profiled is enclosed in PROFILE_BEGIN() and PROFILE_END() for
+ * one of the named sections below. The profiler accumulates the number of calls
+ * and the total time of each section, which is printed by the #profile command.
+ * The macros expand to nothing if USE_PROFILER = 0.
+ *
+ * The time is measured in raster lines (64 us each) with the raster line timer
+ * in raster_time.h. Sections may be nested, in which case the time of the inner
+ * section is also included in the time of the outer section. A section must not
+ * be nested in itself. The interpreter is profiled in batches of opcodes since
+ * profiling each opcode would mostly measure the profiler itself.
+ ******************************************************************************/
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <stdint.h>
+#include "ide_friendly.h"
+
+// Number of opcodes per call of the run game section.
+#define PROFILE_RUN_GAME_BATCH 256
+
+// Profiled sections.
+#define PROFILE_RUN_GAME 0
+#define PROFILE_INPUT 1
+#define PROFILE_OS_INPUT 2
+#define PROFILE_PRINT_MESSAGE 3
+#define PROFILE_OS_FLUSH 4
+#define PROFILE_IMAGE_LOAD 5
+#define PROFILE_NUM_SECTIONS 6
+
+#if USE_PROFILER
+#define PROFILE_BEGIN(section) profile_begin(section)
+#define PROFILE_END(section) profile_end(section)
+#else
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+#endif
+
+/*
+ * Initialize the profiler. Must be called after the interrupt dispatcher has
+ * been installed. Waits for the next frame for synchronizing with the frame
+ * counter.
+ */
+void init_profiler(void);
+
+/*
+ * Mark the beginning of the given section.
+ */
+void profile_begin(uint8_t section) __z88dk_fastcall;
+
+/*
+ * Mark the end of the given section. The time since the corresponding call to
+ * profile_begin() is added to the total time of the section.
+ */
+void profile_end(uint8_t section) __z88dk_fastcall;
+
+/*
+ * Print the number of calls and the total time of each section since the
+ * profiler was initialized.
+ */
+void print_profile(void);
+
+#endif
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of raster_time.h.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <stdint.h>
+
+#include "raster_time.h"
+#include "interrupt_dispatcher.h"
+#include "ide_friendly.h"
+
+// The video line at which the frame counter is incremented, which is not the
+// first active video line.
+static uint16_t frame_start_line;
+
+static uint16_t read_video_line(void)
+{
+    uint8_t line_h;
+    uint8_t line_l;
+
+    // Read the high part again in case the low part wrapped in between.
+    do
+    {
+        line_h = ZXN_READ_REG(REG_ACTIVE_VIDEO_LINE_H);
+        line_l = ZXN_READ_REG(REG_ACTIVE_VIDEO_LINE_L);
+    }
+    while (line_h != ZXN_READ_REG(REG_ACTIVE_VIDEO_LINE_H));
+
+    return ((line_h & 0x01) << 8) | line_l;
+}
+
+void init_raster_time(void)
+{
+    uint16_t frames;
+
+    // Find the video line at which the frame counter is incremented.
+    frames = frame_count;
+    while (frames == frame_count);
+    frame_start_line = read_video_line();
+}
+
+uint32_t get_raster_time(void)
+{
+    uint32_t frames;
+    uint16_t line;
+
+    do
+    {
+        frames = get_frame_count();
+        line = read_video_line();
+    }
+    while ((uint16_t) frames != frame_count);
+
+    line = (line >= frame_start_line) ? line - frame_start_line : line + LINES_PER_FRAME - frame_start_line;
+    return frames * LINES_PER_FRAME + line;
+}
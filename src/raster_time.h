@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Raster line timer shared by the profiler and the image benchmark. Only
+ * compiled if USE_PROFILER = 1 or USE_IMAGE_SLIDESHOW = 1.
+ *
+ * The time is measured in raster lines (64 us each) using the 32-bit frame
+ * counter of the interrupt dispatcher combined with the active video line. A
+ * 50 Hz video mode with 312 raster lines per frame is assumed. The time wraps
+ * around after about 76 hours, which still gives correct elapsed times when
+ * subtracting two times as unsigned 32-bit integers. Frames missed while
+ * interrupts are disabled (e.g. in esxDOS calls) make the measured times too
+ * low.
+ ******************************************************************************/
+
+#ifndef _RASTER_TIME_H
+#define _RASTER_TIME_H
+
+#include <stdint.h>
+#include "ide_friendly.h"
+
+#define LINES_PER_FRAME 312
+
+/*
+ * Synchronize the timer with the frame counter of the interrupt dispatcher.
+ * Must be called after the interrupt dispatcher has been installed and before
+ * get_raster_time() is called. Waits for the next frame.
+ */
+void init_raster_time(void);
+
+/*
+ * Return the current time in raster lines since the interrupt dispatcher was
+ * installed.
+ */
+uint32_t get_raster_time(void);
+
+#endif
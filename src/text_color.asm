@@ -8,6 +8,8 @@
 ;; treatment.
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
+INCLUDE "zconfig.inc"
+
 SECTION code_user
 
 EXTERN __IO_NEXTREG_REG
@@ -19,6 +21,14 @@ EXTERN __REG_PALETTE_VALUE_16
 DEFC TEXT_PALETTE_SIZE = 32
 DEFC DEFAULT_TEXT_PALETTE_INDEX = 1
 
+IF USE_TILEMAP_TEXT
+; Ink of the tilemap in text mode with palette offset 0.
+DEFC INK_PALETTE_INDEX = 1
+ELSE
+; Bright white ink of the ULA screen.
+DEFC INK_PALETTE_INDEX = 15
+ENDIF
+
 ; RGB333 color 110 110 110 = RGB332 0xDB and B1 0x00
 DEFC DEFAULT_TEXT_COLOR_RGB332 = 0xDB
 DEFC DEFAULT_TEXT_COLOR_B1 = 0x00
@@ -80,8 +90,8 @@ decrement_text_palette_index:
    ld (hl),TEXT_PALETTE_SIZE-1
 
 set_text_color:
-   ; update text color at index 15 in the primary ula
-   ; palette while preserving the palette control register
+   ; update text color at the ink index in the primary ula (or
+   ; tilemap) palette while preserving the palette control register
    ; note: default text color is 9-bit while the others are 8-bit
    ld a,__REG_PALETTE_CONTROL
    ld bc,__IO_NEXTREG_REG
@@ -89,8 +99,11 @@ set_text_color:
    inc b
    in a,(c)
    and 0x8f
+IF USE_TILEMAP_TEXT
+   or 0x30                     ; select primary tilemap palette
+ENDIF
    nextreg __REG_PALETTE_CONTROL,a
-   nextreg __REG_PALETTE_INDEX,15
+   nextreg __REG_PALETTE_INDEX,INK_PALETTE_INDEX
    ld hl,text_palette
    ld a,(text_palette_index)
    ; check if default text color
@@ -0,0 +1,315 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; Stefan Bylund 2021
+;;
+;; Text window scrolling using the zxnDMA. Only compiled if USE_DMA_SCROLL = 1.
+;;
+;; The text window is scrolled by moving its screen memory with DMA block copies
+;; instead of with the CPU. For a text window using the whole screen width, the
+;; same pixel line of consecutive character rows within the same third of the
+;; screen is contiguous in screen memory, which means that a whole text window
+;; can be scrolled with about 32 DMA transfers per screen (64 in Timex hi-res
+;; mode). The vacated character rows at the bottom of the text window are
+;; cleared with DMA fills. The attributes are left as they are since the whole
+;; text window uses the same attribute.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+INCLUDE "zconfig.inc"
+
+SECTION code_user
+
+EXTERN __IO_DMA
+
+; zxnDMA WR1 port A configurations (memory with 2 cycles timing).
+DEFC DMA_PORT_A_INCREMENT = 0x54
+DEFC DMA_PORT_A_FIXED = 0x64
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; ASM_TEXT_SCROLL_UP
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+PUBLIC asm_text_scroll_up
+
+asm_text_scroll_up:
+
+   ; Scroll a text window using the whole screen width upwards the given number
+   ; of character rows and clear the vacated character rows at the bottom.
+   ;
+   ; enter : d = window.y (character row)
+   ;         e = window.height (characters)
+   ;         c = number of character rows to scroll
+   ; exit  : none
+   ; uses  : af, bc, de, hl
+
+   ld a,c
+   or a
+   ret z                       ; if nothing to scroll
+
+   cp e
+   jr c, move_rows
+
+   ; the whole window is scrolled out so just clear it
+   ld a,d
+   ld (dst_row),a
+   ld a,e
+   ld (remaining),a
+   jp clear_rows
+
+move_rows:
+
+   ; move the character rows y + c .. y + height - 1 to y .. y + height - c - 1
+   ld a,d
+   ld (dst_row),a
+   add a,c
+   ld (src_row),a
+   ld a,e
+   sub c
+   ld (remaining),a
+   ld a,c
+   ld (cleared),a
+
+move_loop:
+
+   ; rows in run = min(8 - max(dst_row % 8, src_row % 8), remaining)
+   ld a,(dst_row)
+   and 0x07
+   ld b,a
+   ld a,(src_row)
+   and 0x07
+   cp b
+   jr nc, max_found
+   ld a,b
+max_found:
+   neg
+   add a,8
+   ld b,a
+   ld a,(remaining)
+   cp b
+   jr nc, run_found
+   ld b,a
+run_found:
+   ld a,b
+   ld (run_rows),a
+   call rows_length
+   ld (run_length),bc
+
+   ld a,(src_row)
+   call row_address
+   ex de,hl                    ; de = source
+   ld a,(dst_row)
+   call row_address            ; hl = destination
+   ex de,hl                    ; hl = source, de = destination
+
+   ld b,8
+
+move_scanline_loop:
+
+   push bc
+   ld bc,(run_length)
+   ld a,DMA_PORT_A_INCREMENT
+   call dma_transfer
+
+IF USE_TIMEX_HIRES
+
+   ; move the same pixel line in the second screen buffer
+   set 5,h
+   set 5,d
+   ld bc,(run_length)
+   ld a,DMA_PORT_A_INCREMENT
+   call dma_transfer
+   res 5,h
+   res 5,d
+
+ENDIF
+
+   inc h
+   inc d
+   pop bc
+   djnz move_scanline_loop
+
+   ; advance to next run
+   ld a,(run_rows)
+   ld b,a
+   ld hl,dst_row
+   ld a,(hl)
+   add a,b
+   ld (hl),a
+   ld hl,src_row
+   ld a,(hl)
+   add a,b
+   ld (hl),a
+   ld hl,remaining
+   ld a,(hl)
+   sub b
+   ld (hl),a
+   jr nz, move_loop
+
+   ; clear the vacated rows following the moved rows
+   ld a,(cleared)
+   ld (remaining),a
+
+clear_rows:
+
+   ; clear (remaining) character rows starting at (dst_row)
+
+clear_loop:
+
+   ; rows in run = min(8 - dst_row % 8, remaining)
+   ld a,(dst_row)
+   and 0x07
+   neg
+   add a,8
+   ld b,a
+   ld a,(remaining)
+   cp b
+   jr nc, clear_run_found
+   ld b,a
+clear_run_found:
+   ld a,b
+   ld (run_rows),a
+   call rows_length
+   ld (run_length),bc
+
+   ld a,(dst_row)
+   call row_address
+   ex de,hl                    ; de = destination
+   ld hl,zero                  ; hl = source
+
+   ld b,8
+
+clear_scanline_loop:
+
+   push bc
+   ld bc,(run_length)
+   ld a,DMA_PORT_A_FIXED
+   call dma_transfer
+
+IF USE_TIMEX_HIRES
+
+   ; clear the same pixel line in the second screen buffer
+   set 5,d
+   ld bc,(run_length)
+   ld a,DMA_PORT_A_FIXED
+   call dma_transfer
+   res 5,d
+
+ENDIF
+
+   inc d
+   pop bc
+   djnz clear_scanline_loop
+
+   ; advance to next run
+   ld a,(run_rows)
+   ld b,a
+   ld hl,dst_row
+   ld a,(hl)
+   add a,b
+   ld (hl),a
+   ld hl,remaining
+   ld a,(hl)
+   sub b
+   ld (hl),a
+   jr nz, clear_loop
+
+   ret
+
+row_address:
+
+   ; enter : a = character row (0 - 23)
+   ; exit  : hl = screen address of first pixel line of character row
+   ; uses  : af, hl
+
+   ld l,a
+   and 0x18
+   or 0x40
+   ld h,a
+   ld a,l
+   and 0x07
+   rrca
+   rrca
+   rrca
+   ld l,a
+   ret
+
+rows_length:
+
+   ; enter : a = number of character rows (1 - 8)
+   ; exit  : bc = length of a pixel line of the character rows (a * 32)
+   ; uses  : af, bc
+
+   ld c,a
+   ld b,0
+   sla c
+   sla c
+   sla c
+   sla c
+   sla c
+   rl b
+   ret
+
+dma_transfer:
+
+   ; Transfer a block of memory using the zxnDMA in continuous mode.
+   ;
+   ; enter : hl = source address
+   ;         de = destination address
+   ;         bc = length (non-zero)
+   ;          a = port A (source) configuration
+   ; exit  : none
+   ; uses  : af, bc
+
+   ld (dma_source),hl
+   ld (dma_destination),de
+   ld (dma_length),bc
+   ld (dma_port_a),a
+
+   push hl
+   ld hl,dma_program
+   ld bc,+(DMA_PROGRAM_LENGTH << 8) | __IO_DMA
+   otir
+   pop hl
+   ret
+
+SECTION data_user
+
+dma_program:
+   DEFB 0x83                   ; WR6 disable dma
+   DEFB 0x7d                   ; WR0 transfer port a -> port b, start address and length follow
+dma_source:
+   DEFW 0
+dma_length:
+   DEFW 0
+dma_port_a:
+   DEFB DMA_PORT_A_INCREMENT   ; WR1 port a memory, timing follows
+   DEFB 0x02                   ; port a 2 cycles
+   DEFB 0x50                   ; WR2 port b memory incrementing, timing follows
+   DEFB 0x02                   ; port b 2 cycles
+   DEFB 0xad                   ; WR4 continuous mode, port b start address follows
+dma_destination:
+   DEFW 0
+   DEFB 0x82                   ; WR5 stop at end of block
+   DEFB 0xcf                   ; WR6 load
+   DEFB 0x87                   ; WR6 enable dma
+
+DEFC DMA_PROGRAM_LENGTH = ASMPC - dma_program
+
+src_row:
+   DEFB 0
+
+dst_row:
+   DEFB 0
+
+remaining:
+   DEFB 0
+
+cleared:
+   DEFB 0
+
+run_rows:
+   DEFB 0
+
+run_length:
+   DEFW 0
+
+zero:
+   DEFB 0
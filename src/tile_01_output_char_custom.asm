@@ -0,0 +1,504 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+; TILE_01_OUTPUT_CHAR_CUSTOM
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;
+; This output terminal driver subclasses the
+; console_01_output_terminal_char driver and displays the text
+; on the hardware tilemap set up in tilemap_text.asm.
+;
+; A character is printed by writing its ASCII code to the
+; tilemap. If the window covers the whole visible tilemap area,
+; the window is scrolled by changing the y offset of the
+; tilemap and clearing the vacated rows. Otherwise, the rows of
+; the window are moved in the tilemap.
+;
+; Like the zx_01_output_fzx_custom driver, this driver shows a
+; scroll prompt during the scroll pause period, reduces the max
+; scroll when graphics are present on screen, suppresses
+; echoing of newline from the connected input terminal, sets
+; the cursor to '_' even if Caps Lock is on and translates tabs
+; to spaces.
+;
+; The routine tile_01_output_char_custom_erase_input is called
+; by the zx_01_input_kbd_inkey_custom driver for erasing the
+; typed input line when a history key is pressed.
+;
+; ;;;;;;;;;;;;;;;;;;;;
+; DRIVER CLASS DIAGRAM
+; ;;;;;;;;;;;;;;;;;;;;
+;
+; CONSOLE_01_OUTPUT_TERMINAL (root, abstract)
+; CONSOLE_01_OUTPUT_TERMINAL_CHAR (abstract)
+; TILE_01_OUTPUT_CHAR_CUSTOM (concrete)
+
+INCLUDE "zconfig.inc"
+
+SECTION code_driver
+SECTION code_driver_terminal_output
+
+PUBLIC tile_01_output_char_custom
+PUBLIC tile_01_output_char_custom_erase_input
+
+EXTERN console_01_output_terminal_char
+EXTERN asm_in_wait_nokey
+EXTERN asm_in_inkey
+EXTERN asm_z80_delay_ms
+
+EXTERN _image_key_scroll
+EXTERN _image_text_height_in_chars
+EXTERN show_scroll_prompt
+
+IF USE_TYPE_AHEAD
+EXTERN _key_queue_mark
+EXTERN _key_queue_restore
+ENDIF
+
+EXTERN TILEMAP_ADDRESS
+EXTERN TILEMAP_WIDTH
+EXTERN TILEMAP_TEXT_Y
+EXTERN TILEMAP_TEXT_HEIGHT
+
+EXTERN OTERM_MSG_PUTC
+EXTERN OTERM_MSG_PRINTC
+EXTERN OTERM_MSG_BELL
+EXTERN OTERM_MSG_SCROLL
+EXTERN OTERM_MSG_CLS
+EXTERN OTERM_MSG_PAUSE
+EXTERN OTERM_MSG_SCROLL_LIMIT
+EXTERN ITERM_MSG_READLINE_SCROLL_LIMIT
+EXTERN ITERM_MSG_PUTC
+EXTERN ITERM_MSG_PRINT_CURSOR
+
+defc ASCII_CODE_TAB = 9
+defc ASCII_CODE_LF = 10
+defc ASCII_CODE_SPACE = 32
+
+defc REG_TILEMAP_OFFSET_Y = 0x31
+
+tile_01_output_char_custom:
+
+   cp OTERM_MSG_PRINTC
+   jr z, oterm_msg_printc
+
+   cp OTERM_MSG_PUTC
+   jr z, oterm_msg_putc
+
+   cp OTERM_MSG_SCROLL
+   jp z, oterm_msg_scroll
+
+   cp OTERM_MSG_CLS
+   jp z, oterm_msg_cls
+
+   cp OTERM_MSG_BELL
+   ret z
+
+   cp OTERM_MSG_SCROLL_LIMIT
+   jp z, oterm_msg_scroll_limit
+
+   cp ITERM_MSG_READLINE_SCROLL_LIMIT
+   jp z, iterm_msg_readline_scroll_limit
+
+   cp ITERM_MSG_PUTC
+   jp z, iterm_msg_putc
+
+   cp ITERM_MSG_PRINT_CURSOR
+   jp z, iterm_msg_print_cursor
+
+   cp OTERM_MSG_PAUSE
+   jp z, oterm_msg_pause
+
+   ; let parent class handle other messages
+   jp console_01_output_terminal_char
+
+oterm_msg_printc:
+
+   ; OTERM_MSG_PRINTC:
+   ;
+   ; enter  :  c = ascii code >= 32
+   ;           l = absolute x coordinate
+   ;           h = absolute y coordinate
+   ; can use:  af, bc, de, hl
+   ;
+   ; Print the given character by writing it to the tilemap.
+
+   ld a,h
+   call row_address            ; de = tilemap address of row
+   ld a,l
+   add de,a
+   ld a,c
+   ld (de),a
+   ret
+
+oterm_msg_putc:
+
+   ; OTERM_MSG_PUTC:
+   ;
+   ; enter  :  c = char to output
+   ; can use:  af, bc, de, hl
+   ;
+   ; Output given character and translate tab to space.
+
+   ld a,c
+   cp ASCII_CODE_TAB
+   jr nz, not_tab
+   ld c,ASCII_CODE_SPACE
+not_tab:
+   ld a,OTERM_MSG_PUTC
+   jp console_01_output_terminal_char
+
+oterm_msg_scroll:
+
+   ; OTERM_MSG_SCROLL:
+   ;
+   ; enter  :  c = number of rows to scroll
+   ; can use:  af, bc, de, hl
+   ;
+   ; Scroll the window upward 'c' character rows.
+
+   ld a,c
+   cp (ix+19)
+   jr nc, oterm_msg_cls        ; if the whole window is scrolled out
+
+   ld a,(ix+16)                ; a = window.x
+   or a
+   jr nz, move_rows
+
+   ld a,(ix+17)                ; a = window.width
+   cp TILEMAP_WIDTH
+   jr nz, move_rows
+
+   ld a,(ix+18)                ; a = window.y
+   cp TILEMAP_TEXT_Y
+   jr nz, move_rows
+
+   ld a,(ix+19)                ; a = window.height
+   cp TILEMAP_TEXT_HEIGHT
+   jr nz, move_rows
+
+   ; the window covers the whole visible tilemap area so scroll the tilemap
+   ld a,(scroll_rows)
+   add a,c
+   and 0x1f
+   ld (scroll_rows),a
+   add a,a
+   add a,a
+   add a,a
+   nextreg REG_TILEMAP_OFFSET_Y,a
+
+   ; clear the vacated rows at the bottom of the window
+   ld a,(ix+18)
+   add a,(ix+19)
+   sub c                       ; a = first vacated row
+   ld b,c                      ; b = number of vacated rows
+   jr clear_rows
+
+move_rows:
+
+   ld a,(ix+19)
+   sub c
+   ld b,a                      ; b = number of rows to move
+   ld a,(ix+18)                ; a = destination row
+
+move_row:
+
+   push af
+   add a,c
+   call row_address
+   ex de,hl                    ; hl = source row address
+   pop af
+   push af
+   call row_address            ; de = destination row address
+   ld a,(ix+16)
+   add hl,a
+   add de,a
+   push bc
+   ld c,(ix+17)
+   ld b,0
+   ldir
+   pop bc
+   pop af
+   inc a
+   djnz move_row
+
+   ; clear the vacated rows at the bottom of the window
+   ld b,c                      ; b = number of vacated rows
+   jr clear_rows
+
+oterm_msg_cls:
+
+   ; OTERM_MSG_CLS:
+   ;
+   ; can use:  af, bc, de, hl, ix
+   ;
+   ; Clear the window.
+
+   ld a,(ix+18)                ; a = window.y
+   ld b,(ix+19)                ; b = window.height
+
+clear_rows:
+
+   ; enter : a = first absolute row to clear
+   ;         b = number of rows to clear
+
+   push af
+   call row_address
+   ld a,(ix+16)
+   add de,a
+   push bc
+   ld b,(ix+17)
+   ld a,ASCII_CODE_SPACE
+clear_row:
+   ld (de),a
+   inc de
+   djnz clear_row
+   pop bc
+   pop af
+   inc a
+   djnz clear_rows
+   ret
+
+row_address:
+
+   ; enter : a = absolute row
+   ; exit  : de = tilemap address of row
+   ; uses  : af, de
+
+   push hl
+   ld hl,scroll_rows
+   add a,(hl)
+   and 0x1f
+   ld d,a
+   ld e,TILEMAP_WIDTH
+   mul d,e
+   add de,TILEMAP_ADDRESS
+   pop hl
+   ret
+
+oterm_msg_pause:
+
+   ; OTERM_MSG_PAUSE:
+   ; The scroll count has reached zero so the driver should pause the output somehow.
+   ;
+   ; can use: af, bc, de, hl
+
+   ; show the scroll prompt
+   ld l,1
+   call show_scroll_prompt
+
+IF USE_TYPE_AHEAD
+   ; the keys pressed during the scroll pause period are not typed ahead
+   call _key_queue_mark
+   push hl
+ENDIF
+
+   ; wait for a key press and allow image scrolling during the scroll pause period
+
+   call asm_in_wait_nokey
+
+wait:
+
+   call asm_in_inkey
+   ld a,l                      ; a = ascii code keypress
+
+   or a
+   jr z, wait                  ; if no keypress
+
+IF USE_GFX
+
+   call _image_key_scroll      ; image scroll for up/down
+   jr c, wait_done             ; if up/down not detected
+
+   ld hl,KEY_REPEAT_RATE
+   call asm_z80_delay_ms       ; scroll speed kept consistent with scrolling in input terminal
+
+   jr wait
+
+ENDIF
+
+wait_done:
+
+   call asm_in_wait_nokey
+
+IF USE_TYPE_AHEAD
+   pop hl
+   call _key_queue_restore
+ENDIF
+
+   ; hide the scroll prompt
+   ld l,0
+   call show_scroll_prompt
+
+   ret
+
+oterm_msg_scroll_limit:
+
+   ; OTERM_MSG_SCROLL_LIMIT (optional):
+   ;
+   ; enter  :  c = default
+   ; exit   :  c = maximum scroll amount
+   ; can use:  af, bc, de, hl
+   ;
+   ; Scroll has just paused. Return number of scrolls until next pause.
+   ; Default is window height.
+
+IF USE_GFX
+
+   call _image_text_height_in_chars ; a = image height in text window in characters
+
+   sub TEXT_WINDOW_HEIGHT
+   neg                              ; a = TEXT_WINDOW_HEIGHT - image_text_height_in_chars
+
+   ld c,a
+
+ENDIF
+
+   ret
+
+iterm_msg_readline_scroll_limit:
+
+   ; ITERM_MSG_READLINE_SCROLL_LIMIT (optional):
+   ;
+   ; enter  :  c = default
+   ; exit   :  c = number of rows to scroll before pause
+   ; can use:  af, bc, de, hl
+   ;
+   ; Return number of scrolls allowed before pause after
+   ; a readline operation ends. Default is current y + 1.
+
+IF USE_GFX
+
+   call _image_text_height_in_chars ; a = image height in text window in characters
+
+   ; Note: This assumes that the cursor position is never behind the image.
+   sub c
+   neg                              ; a = (y + 1) - image_text_height_in_chars
+
+   ld c,a
+
+ENDIF
+
+   ret
+
+iterm_msg_putc:
+
+   ; ITERM_MSG_PUTC:
+   ;
+   ; enter  :  c = char to output
+   ; can use:  af, bc, de, hl
+   ;
+   ; Output given character if not newline.
+
+   ld a,c
+   cp ASCII_CODE_LF
+   ret z
+   ld a,ITERM_MSG_PUTC
+   jp console_01_output_terminal_char
+
+iterm_msg_print_cursor:
+
+   ; ITERM_MSG_PRINT_CURSOR:
+   ;
+   ; enter  :  c = cursor char (CHAR_CURSOR_LC or CHAR_CURSOR_UC)
+   ; can use:  af, bc, de, hl, ix
+   ;
+   ; Input terminal is printing the given cursor.
+   ; Set cursor to '_' (CHAR_CURSOR_LC) even if caps lock is on.
+
+   ld c,'_'
+   jp console_01_output_terminal_char
+
+tile_01_output_char_custom_erase_input:
+
+   ; Erase the characters typed on the input line and the cursor following them
+   ; by writing spaces to the tilemap and move the cursor back to the start of
+   ; the input line.
+   ;
+   ; enter : ix = FDSTRUCT.JP *output_terminal
+   ;         de = number of typed characters (edit buffer size)
+   ; exit  : none
+   ; uses  : af, bc, de, hl
+
+   ; find the start of the input line by going back de characters from x,y
+   ld l,(ix+14)
+   ld h,0                      ; hl = x
+   ld b,(ix+15)                ; b = y
+   or a
+   sbc hl,de                   ; hl = x - number of typed characters
+
+find_start:
+
+   bit 7,h
+   jr z, start_found           ; if x >= 0
+
+   ld a,b
+   or a
+   jr z, start_at_top          ; if the input line has scrolled out of the window
+
+   ld a,(ix+17)
+   add hl,a                    ; x += window.width
+   dec b                       ; y -= 1
+   jr find_start
+
+start_at_top:
+
+   ld l,0
+
+start_found:
+
+   ld c,l                      ; c = start x
+   push bc                     ; save start x,y
+
+erase_loop:
+
+   ; erase the characters from the start of the input line up to and including
+   ; the cursor position, the x coordinate may equal window.width at the end of
+   ; a row if the next character would wrap to the next row
+
+   ld a,c
+   cp (ix+17)
+   jr nc, erase_cell_done      ; if x is beyond the last column of the window
+
+   ld a,(ix+18)
+   add a,b
+   call row_address            ; de = tilemap address of absolute row y
+   ld a,(ix+16)
+   add a,c
+   add de,a
+   ld a,ASCII_CODE_SPACE
+   ld (de),a
+
+erase_cell_done:
+
+   ld a,c
+   cp (ix+14)
+   jr nz, erase_next
+   ld a,b
+   cp (ix+15)
+   jr z, erase_done            ; if the cursor position has been erased
+
+erase_next:
+
+   inc c
+   ld a,c
+   cp (ix+17)
+   jr c, erase_loop
+   jr z, erase_loop            ; keep x = window.width for a pending wrap
+
+   ld c,0
+   inc b
+   jr erase_loop
+
+erase_done:
+
+   ; move the cursor to the start of the input line
+   pop bc
+   ld (ix+14),c
+   ld (ix+15),b
+   ret
+
+SECTION data_user
+
+scroll_rows:
+
+   ; number of rows the tilemap is scrolled vertically
+   DEFB 0
@@ -0,0 +1,201 @@
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; Stefan Bylund 2021
+;;
+;; Support for displaying the text window on the hardware tilemap instead of on
+;; the ULA screen. Only compiled if USE_TILEMAP_TEXT = 1.
+;;
+;; The tilemap is used in 80 x 32 text mode (1-bit tiles) without attribute
+;; bytes, which means that a character is displayed by writing its ASCII code
+;; to the tilemap. The tilemap and its tile definitions are located in the ULA
+;; screen memory of bank 5, which is free since the ULA screen is disabled.
+;; The tile definitions are the glyphs of the QLStyle font pre-rendered into
+;; 8 x 8 pixel tiles. The tilemap is displayed below the layer 2 screen and has
+;; the same vertical position as the ULA screen, i.e. the text window starts at
+;; tilemap row 4.
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+SECTION code_user
+
+PUBLIC TILEMAP_ADDRESS
+PUBLIC TILEMAP_WIDTH
+PUBLIC TILEMAP_HEIGHT
+PUBLIC TILEMAP_TEXT_Y
+PUBLIC TILEMAP_TEXT_HEIGHT
+
+defc TILEMAP_ADDRESS = 0x4000
+defc TILEMAP_WIDTH = 80
+defc TILEMAP_HEIGHT = 32
+defc TILEMAP_SIZE = TILEMAP_WIDTH * TILEMAP_HEIGHT
+defc TILEMAP_TEXT_Y = 4
+defc TILEMAP_TEXT_HEIGHT = 24
+
+defc TILE_DEFINITIONS_ADDRESS = 0x4A00
+defc TILE_FONT_FIRST_CHAR = 32
+defc TILE_FONT_NUM_CHARS = 96
+
+defc REG_CLIP_WINDOW_TILEMAP = 0x1B
+defc REG_CLIP_WINDOW_CONTROL = 0x1C
+defc REG_TILEMAP_OFFSET_X_MSB = 0x2F
+defc REG_TILEMAP_OFFSET_X_LSB = 0x30
+defc REG_TILEMAP_OFFSET_Y = 0x31
+defc REG_ULA_CONTROL = 0x68
+defc REG_TILEMAP_CONTROL = 0x6B
+defc REG_TILEMAP_ATTRIBUTE = 0x6C
+defc REG_TILEMAP_BASE_ADDRESS = 0x6E
+defc REG_TILE_DEFINITIONS_BASE_ADDRESS = 0x6F
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+;; _INIT_TILEMAP_TEXT
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+PUBLIC _init_tilemap_text
+
+_init_tilemap_text:
+
+   ; Disable the ULA screen and enable the tilemap in 80 x 32 text mode.
+   ;
+   ; enter : none
+   ; exit  : none
+   ; uses  : af, bc, de, hl
+
+   ; disable ula screen
+   nextreg REG_ULA_CONTROL,0x80
+
+   ; copy the tile font to the tile definitions
+   ld hl,tile_font
+   ld de,TILE_DEFINITIONS_ADDRESS + TILE_FONT_FIRST_CHAR * 8
+   ld bc,TILE_FONT_NUM_CHARS * 8
+   ldir
+
+   ; clear the tilemap with spaces
+   ld hl,TILEMAP_ADDRESS
+   ld de,TILEMAP_ADDRESS + 1
+   ld bc,TILEMAP_SIZE - 1
+   ld (hl),' '
+   ldir
+
+   ; set tilemap and tile definitions base addresses (offsets in bank 5)
+   nextreg REG_TILEMAP_BASE_ADDRESS,(TILEMAP_ADDRESS - 0x4000) / 256
+   nextreg REG_TILE_DEFINITIONS_BASE_ADDRESS,(TILE_DEFINITIONS_ADDRESS - 0x4000) / 256
+
+   ; use palette offset 0, i.e. tilemap palette index 0 for paper and 1 for ink
+   nextreg REG_TILEMAP_ATTRIBUTE,0
+
+   ; reset tilemap scroll offsets
+   nextreg REG_TILEMAP_OFFSET_X_MSB,0
+   nextreg REG_TILEMAP_OFFSET_X_LSB,0
+   nextreg REG_TILEMAP_OFFSET_Y,0
+
+   ; clip the tilemap to the area of the ula screen (x-coordinates are halved)
+   nextreg REG_CLIP_WINDOW_CONTROL,0x08
+   nextreg REG_CLIP_WINDOW_TILEMAP,0
+   nextreg REG_CLIP_WINDOW_TILEMAP,159
+   nextreg REG_CLIP_WINDOW_TILEMAP,TILEMAP_TEXT_Y * 8
+   nextreg REG_CLIP_WINDOW_TILEMAP,(TILEMAP_TEXT_Y + TILEMAP_TEXT_HEIGHT) * 8 - 1
+
+   ; enable tilemap in 80 x 32 text mode without attribute bytes
+   nextreg REG_TILEMAP_CONTROL,0xe8
+   ret
+
+SECTION rodata_user
+
+; The QLStyle font for Timex hi-res mode (QLStyle_tshr.fzx) pre-rendered into
+; 8 x 8 pixel tiles for the characters 32 - 127.
+
+tile_font:
+   DEFB 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00 ; 32 space
+   DEFB 0x80,0x80,0x80,0x80,0x00,0x80,0x00,0x00 ; 33 !
+   DEFB 0xa0,0xa0,0x00,0x00,0x00,0x00,0x00,0x00 ; 34 "
+   DEFB 0x00,0x48,0xfc,0x48,0xfc,0x48,0x00,0x00 ; 35 #
+   DEFB 0x20,0xf8,0xa0,0xf8,0x28,0xf8,0x20,0x00 ; 36 $
+   DEFB 0x00,0x88,0x10,0x20,0x40,0x88,0x00,0x00 ; 37 %
+   DEFB 0x60,0x90,0x60,0x94,0x88,0x74,0x00,0x00 ; 38 &
+   DEFB 0x80,0x80,0x00,0x00,0x00,0x00,0x00,0x00 ; 39 '
+   DEFB 0x40,0x80,0x80,0x80,0x80,0x40,0x00,0x00 ; 40 (
+   DEFB 0x80,0x40,0x40,0x40,0x40,0x80,0x00,0x00 ; 41 )
+   DEFB 0x00,0x50,0x20,0xf8,0x20,0x50,0x00,0x00 ; 42 *
+   DEFB 0x00,0x20,0x20,0xf8,0x20,0x20,0x00,0x00 ; 43 +
+   DEFB 0x00,0x00,0x00,0x00,0x00,0x40,0x80,0x00 ; 44 ,
+   DEFB 0x00,0x00,0x00,0xf0,0x00,0x00,0x00,0x00 ; 45 -
+   DEFB 0x00,0x00,0x00,0x00,0x00,0x80,0x00,0x00 ; 46 .
+   DEFB 0x04,0x08,0x10,0x20,0x40,0x80,0x00,0x00 ; 47 /
+   DEFB 0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00 ; 48 0
+   DEFB 0x20,0x60,0x20,0x20,0x20,0x70,0x00,0x00 ; 49 1
+   DEFB 0x70,0x88,0x08,0x70,0x80,0xf8,0x00,0x00 ; 50 2
+   DEFB 0x70,0x88,0x10,0x08,0x88,0x70,0x00,0x00 ; 51 3
+   DEFB 0x18,0x28,0x48,0x88,0xf8,0x08,0x00,0x00 ; 52 4
+   DEFB 0xf8,0x80,0xf0,0x08,0x08,0xf0,0x00,0x00 ; 53 5
+   DEFB 0x70,0x80,0xf0,0x88,0x88,0x70,0x00,0x00 ; 54 6
+   DEFB 0xf8,0x08,0x10,0x20,0x20,0x20,0x00,0x00 ; 55 7
+   DEFB 0x70,0x88,0x70,0x88,0x88,0x70,0x00,0x00 ; 56 8
+   DEFB 0x70,0x88,0x88,0x78,0x08,0x70,0x00,0x00 ; 57 9
+   DEFB 0x00,0x00,0x80,0x00,0x00,0x80,0x00,0x00 ; 58 :
+   DEFB 0x00,0x00,0x40,0x00,0x00,0x40,0x80,0x00 ; 59 ;
+   DEFB 0x00,0x20,0x40,0x80,0x40,0x20,0x00,0x00 ; 60 <
+   DEFB 0x00,0x00,0xf0,0x00,0xf0,0x00,0x00,0x00 ; 61 =
+   DEFB 0x00,0x80,0x40,0x20,0x40,0x80,0x00,0x00 ; 62 >
+   DEFB 0x70,0x88,0x10,0x20,0x00,0x20,0x00,0x00 ; 63 ?
+   DEFB 0x78,0x84,0xbc,0xa4,0xbc,0x80,0x78,0x00 ; 64 @
+   DEFB 0x70,0x88,0x88,0xf8,0x88,0x88,0x00,0x00 ; 65 A
+   DEFB 0xf0,0x88,0xf0,0x88,0x88,0xf0,0x00,0x00 ; 66 B
+   DEFB 0x78,0x80,0x80,0x80,0x80,0x78,0x00,0x00 ; 67 C
+   DEFB 0xf0,0x88,0x88,0x88,0x88,0xf0,0x00,0x00 ; 68 D
+   DEFB 0xf8,0x80,0xf0,0x80,0x80,0xf8,0x00,0x00 ; 69 E
+   DEFB 0xf8,0x80,0xf0,0x80,0x80,0x80,0x00,0x00 ; 70 F
+   DEFB 0x70,0x80,0x98,0x88,0x88,0x70,0x00,0x00 ; 71 G
+   DEFB 0x88,0x88,0xf8,0x88,0x88,0x88,0x00,0x00 ; 72 H
+   DEFB 0x80,0x80,0x80,0x80,0x80,0x80,0x00,0x00 ; 73 I
+   DEFB 0x08,0x08,0x08,0x08,0x88,0x70,0x00,0x00 ; 74 J
+   DEFB 0x88,0x90,0xe0,0x90,0x88,0x88,0x00,0x00 ; 75 K
+   DEFB 0x80,0x80,0x80,0x80,0x80,0xf8,0x00,0x00 ; 76 L
+   DEFB 0x82,0xc6,0xaa,0x92,0x82,0x82,0x00,0x00 ; 77 M
+   DEFB 0x84,0xc4,0xa4,0x94,0x8c,0x84,0x00,0x00 ; 78 N
+   DEFB 0x70,0x88,0x88,0x88,0x88,0x70,0x00,0x00 ; 79 O
+   DEFB 0xf0,0x88,0x88,0xf0,0x80,0x80,0x00,0x00 ; 80 P
+   DEFB 0x70,0x88,0x88,0x88,0x90,0x68,0x00,0x00 ; 81 Q
+   DEFB 0xf0,0x88,0x88,0xf0,0x88,0x88,0x00,0x00 ; 82 R
+   DEFB 0x70,0x80,0x70,0x08,0x88,0x70,0x00,0x00 ; 83 S
+   DEFB 0xf8,0x20,0x20,0x20,0x20,0x20,0x00,0x00 ; 84 T
+   DEFB 0x88,0x88,0x88,0x88,0x88,0x70,0x00,0x00 ; 85 U
+   DEFB 0x84,0x84,0x84,0x84,0x48,0x30,0x00,0x00 ; 86 V
+   DEFB 0x82,0x82,0x92,0x92,0x92,0x6c,0x00,0x00 ; 87 W
+   DEFB 0x84,0x48,0x30,0x48,0x84,0x84,0x00,0x00 ; 88 X
+   DEFB 0x82,0x44,0x28,0x10,0x10,0x10,0x00,0x00 ; 89 Y
+   DEFB 0xfc,0x08,0x10,0x20,0x40,0xfc,0x00,0x00 ; 90 Z
+   DEFB 0xc0,0x80,0x80,0x80,0x80,0xc0,0x00,0x00 ; 91 [
+   DEFB 0x80,0x40,0x20,0x10,0x08,0x04,0x00,0x00 ; 92 backslash
+   DEFB 0xc0,0x40,0x40,0x40,0x40,0xc0,0x00,0x00 ; 93 ]
+   DEFB 0x40,0xa0,0x00,0x00,0x00,0x00,0x00,0x00 ; 94 ^
+   DEFB 0x00,0x00,0x00,0x00,0x00,0x00,0xf8,0x00 ; 95 _
+   DEFB 0x80,0x40,0x00,0x00,0x00,0x00,0x00,0x00 ; 96 `
+   DEFB 0x00,0x70,0x08,0x78,0x88,0x78,0x00,0x00 ; 97 a
+   DEFB 0x80,0xf0,0x88,0x88,0x88,0xf0,0x00,0x00 ; 98 b
+   DEFB 0x00,0x70,0x80,0x80,0x80,0x70,0x00,0x00 ; 99 c
+   DEFB 0x08,0x78,0x88,0x88,0x88,0x78,0x00,0x00 ; 100 d
+   DEFB 0x00,0x70,0x88,0xf8,0x80,0x78,0x00,0x00 ; 101 e
+   DEFB 0x70,0x80,0xe0,0x80,0x80,0x80,0x00,0x00 ; 102 f
+   DEFB 0x00,0x70,0x88,0x88,0x78,0x08,0x70,0x00 ; 103 g
+   DEFB 0x80,0xf0,0x88,0x88,0x88,0x88,0x00,0x00 ; 104 h
+   DEFB 0x80,0x00,0x80,0x80,0x80,0x80,0x00,0x00 ; 105 i
+   DEFB 0x10,0x00,0x10,0x10,0x10,0x10,0xe0,0x00 ; 106 j
+   DEFB 0x80,0x88,0x90,0xe0,0x90,0x88,0x00,0x00 ; 107 k
+   DEFB 0x80,0x80,0x80,0x80,0x80,0x60,0x00,0x00 ; 108 l
+   DEFB 0x00,0xec,0x92,0x92,0x92,0x92,0x00,0x00 ; 109 m
+   DEFB 0x00,0xf0,0x88,0x88,0x88,0x88,0x00,0x00 ; 110 n
+   DEFB 0x00,0x70,0x88,0x88,0x88,0x70,0x00,0x00 ; 111 o
+   DEFB 0x00,0xf0,0x88,0x88,0x88,0xf0,0x80,0x00 ; 112 p
+   DEFB 0x00,0x78,0x88,0x88,0x88,0x78,0x08,0x00 ; 113 q
+   DEFB 0x00,0x70,0x80,0x80,0x80,0x80,0x00,0x00 ; 114 r
+   DEFB 0x00,0x70,0x80,0x70,0x08,0xf0,0x00,0x00 ; 115 s
+   DEFB 0x80,0xe0,0x80,0x80,0x80,0x70,0x00,0x00 ; 116 t
+   DEFB 0x00,0x88,0x88,0x88,0x88,0x70,0x00,0x00 ; 117 u
+   DEFB 0x00,0x84,0x84,0x48,0x48,0x30,0x00,0x00 ; 118 v
+   DEFB 0x00,0x82,0x92,0x92,0x92,0x6c,0x00,0x00 ; 119 w
+   DEFB 0x00,0x84,0x48,0x30,0x48,0x84,0x00,0x00 ; 120 x
+   DEFB 0x00,0x88,0x88,0x88,0x78,0x08,0x70,0x00 ; 121 y
+   DEFB 0x00,0xf8,0x10,0x20,0x40,0xf8,0x00,0x00 ; 122 z
+   DEFB 0x20,0x40,0x40,0x80,0x40,0x40,0x20,0x00 ; 123 {
+   DEFB 0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x00 ; 124 |
+   DEFB 0x80,0x40,0x40,0x20,0x40,0x40,0x80,0x00 ; 125 }
+   DEFB 0x00,0x00,0x50,0xa0,0x00,0x00,0x00,0x00 ; 126 ~
+   DEFB 0x38,0x44,0xba,0xa2,0xba,0x44,0x38,0x00 ; 127 copyright
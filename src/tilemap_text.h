@@ -0,0 +1,14 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * C API for functions in tilemap_text.asm.
+ ******************************************************************************/
+
+#ifndef _TILEMAP_TEXT_H
+#define _TILEMAP_TEXT_H
+
+#include "ide_friendly.h"
+
+extern void init_tilemap_text(void);
+
+#endif
@@ -24,6 +24,10 @@
 ; The driver also translates tabs to spaces when printing on
 ; the output terminal.
 ;
+; If USE_DMA_SCROLL is enabled, the driver also overrides the
+; scrolling of the text window by moving the screen memory
+; using the zxnDMA instead of the CPU.
+;
 ; ;;;;;;;;;;;;;;;;;;;;
 ; DRIVER CLASS DIAGRAM
 ; ;;;;;;;;;;;;;;;;;;;;
@@ -48,11 +52,19 @@ EXTERN asm_in_wait_nokey
 EXTERN asm_in_inkey
 EXTERN asm_z80_delay_ms
 
+EXTERN asm_text_scroll_up
+
 EXTERN _image_key_scroll
 EXTERN _image_text_height_in_chars
 EXTERN show_scroll_prompt
 
+IF USE_TYPE_AHEAD
+EXTERN _key_queue_mark
+EXTERN _key_queue_restore
+ENDIF
+
 EXTERN OTERM_MSG_PUTC
+EXTERN OTERM_MSG_SCROLL
 EXTERN OTERM_MSG_PAUSE
 EXTERN OTERM_MSG_SCROLL_LIMIT
 EXTERN ITERM_MSG_READLINE_SCROLL_LIMIT
@@ -63,6 +75,8 @@ defc ASCII_CODE_TAB = 9
 defc ASCII_CODE_LF = 10
 defc ASCII_CODE_SPACE = 32
 
+defc SCREEN_WIDTH_IN_CHARS = 64
+
 tshr_01_output_fzx_custom:
 
    cp OTERM_MSG_PUTC
@@ -80,6 +94,13 @@ tshr_01_output_fzx_custom:
    cp ITERM_MSG_PRINT_CURSOR
    jr z, iterm_msg_print_cursor
 
+IF USE_DMA_SCROLL
+
+   cp OTERM_MSG_SCROLL
+   jp z, oterm_msg_scroll
+
+ENDIF
+
    cp OTERM_MSG_PAUSE
    ; let parent class handle other messages
    jp nz, tshr_01_output_fzx
@@ -95,6 +116,12 @@ oterm_msg_pause:
    ld l,1
    call show_scroll_prompt
 
+IF USE_TYPE_AHEAD
+   ; the keys pressed during the scroll pause period are not typed ahead
+   call _key_queue_mark
+   push hl
+ENDIF
+
    ; wait for a key press and allow image scrolling during the scroll pause period
 
    call asm_in_wait_nokey
@@ -123,6 +150,11 @@ wait_done:
 
    call asm_in_wait_nokey
 
+IF USE_TYPE_AHEAD
+   pop hl
+   call _key_queue_restore
+ENDIF
+
    ; hide the scroll prompt
    ld l,0
    call show_scroll_prompt
@@ -220,3 +252,35 @@ iterm_msg_print_cursor:
 
    ld c,'_'
    jp console_01_output_fzx_iterm_msg_print_cursor
+
+IF USE_DMA_SCROLL
+
+oterm_msg_scroll:
+
+   ; OTERM_MSG_SCROLL:
+   ;
+   ; enter  :  c = number of rows to scroll
+   ; can use:  af, bc, de, hl
+   ;
+   ; Scroll the window upward 'c' character rows using the
+   ; zxnDMA if the window spans the whole screen width,
+   ; otherwise let the parent class scroll the window.
+
+   ld a,(ix+16)                ; a = window.x
+   or a
+   jr nz, parent_scroll
+
+   ld a,(ix+17)                ; a = window.width
+   cp SCREEN_WIDTH_IN_CHARS
+   jr nz, parent_scroll
+
+   ld d,(ix+18)                ; d = window.y
+   ld e,(ix+19)                ; e = window.height
+   jp asm_text_scroll_up
+
+parent_scroll:
+
+   ld a,OTERM_MSG_SCROLL
+   jp tshr_01_output_fzx
+
+ENDIF
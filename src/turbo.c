@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of turbo.h.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "turbo.h"
+#include "interrupt_dispatcher.h"
+#include "ide_friendly.h"
+
+static bool slow = false;
+
+static uint16_t last_frame;
+
+static uint32_t fast_frames = 0;
+
+static uint32_t slow_frames = 0;
+
+static void update_turbo_frames(void)
+{
+    uint16_t now = frame_count;
+    uint16_t elapsed = now - last_frame;
+
+    last_frame = now;
+
+    if (slow)
+    {
+        slow_frames += elapsed;
+    }
+    else
+    {
+        fast_frames += elapsed;
+    }
+}
+
+void init_turbo(void)
+{
+    slow = false;
+    last_frame = frame_count;
+}
+
+void turbo_idle(uint16_t idle_frames) __z88dk_fastcall
+{
+    // Account the time often enough for the frame counter not to wrap around.
+    update_turbo_frames();
+
+    if (!slow && (idle_frames >= TURBO_IDLE_FRAMES))
+    {
+        ZXN_NEXTREG(REG_TURBO_MODE, 0x00); // Use RTM_3MHZ when included in z88dk
+        slow = true;
+    }
+}
+
+void turbo_busy(void)
+{
+    if (slow)
+    {
+        update_turbo_frames();
+        ZXN_NEXTREG(REG_TURBO_MODE, 0x03); // Use RTM_28MHZ when included in z88dk
+        slow = false;
+    }
+}
+
+void get_turbo_frames(uint32_t *fast_frames_out, uint32_t *slow_frames_out)
+{
+    update_turbo_frames();
+    *fast_frames_out = fast_frames;
+    *slow_frames_out = slow_frames;
+}
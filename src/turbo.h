@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Adaptive CPU speed control. Only compiled if USE_ADAPTIVE_TURBO = 1.
+ *
+ * The CPU normally runs at 28 MHz. When the interpreter has been blocked waiting
+ * for a key in the type-ahead keyboard queue for a while, the CPU is slowed down
+ * to 3.5 MHz to save power. It is put back to 28 MHz as soon as a key is read
+ * from the queue, i.e. before the interpreter continues. The delay before
+ * slowing down gives hysteresis so that the CPU speed is not switched back and
+ * forth while the player is typing.
+ ******************************************************************************/
+
+#ifndef _TURBO_H
+#define _TURBO_H
+
+#include <stdint.h>
+#include "ide_friendly.h"
+
+// Number of idle frames before the CPU is slowed down (1 s).
+#define TURBO_IDLE_FRAMES 50
+
+/*
+ * Start accounting the time spent at each CPU speed. The CPU is assumed to run
+ * at 28 MHz.
+ */
+void init_turbo(void);
+
+/*
+ * Called once per frame while waiting for a key with the number of frames
+ * waited so far. Slows down the CPU to 3.5 MHz when the number of idle frames
+ * has reached TURBO_IDLE_FRAMES.
+ */
+void turbo_idle(uint16_t idle_frames) __z88dk_fastcall;
+
+/*
+ * Put the CPU back to 28 MHz if it has been slowed down.
+ */
+void turbo_busy(void);
+
+/*
+ * Return the number of frames spent at 28 MHz and at 3.5 MHz, respectively,
+ * since init_turbo() was called.
+ */
+void get_turbo_frames(uint32_t *fast_frames_out, uint32_t *slow_frames_out);
+
+#endif
@@ -10,16 +10,24 @@
 ; (right) are rejected. Allows enter at end of input when buffer
 ; is full.
 ;
-; Intercepts the ITERM_MSG_GETC message to detect if EDIT (CAPS+1)
-; is typed on the input line. If EDIT is pressed, the input
-; terminal is cleared (in preparation for the calling program
-; to insert from history buffer) and the edit_pressed variable
-; is set and getc() is made to return error.
+; Intercepts the ITERM_MSG_GETC message to detect if a history
+; key is typed on the input line, i.e. EDIT (CAPS+1) or, if the
+; graphics is off, CAPS+7 (up) and CAPS+6 (down). If a history
+; key is pressed and the command history is not empty, the typed
+; input is copied to the history_typed buffer (to be used as the
+; prefix when searching the history), the input terminal is
+; cleared (in preparation for the calling program to insert the
+; recalled history entry), the history_key variable is set to
+; the pressed key and getc() is made to return error.
 ;
 ; The colour of the text can be changed by cycling downwards or
 ; upwards through a palette of 32 colours by pressing TRUE_VIDEO
 ; (CAPS+3) and INV_VIDEO (CAPS+4), respectively.
 ;
+; If USE_TYPE_AHEAD is enabled, the keys are read from the type-
+; ahead keyboard queue filled by an IM2 ISR instead of from the
+; keyboard.
+;
 ; ;;;;;;;;;;;;;;;;;;;;
 ; DRIVER CLASS DIAGRAM
 ; ;;;;;;;;;;;;;;;;;;;;
@@ -41,13 +49,25 @@ EXTERN ITERM_MSG_PUTC
 EXTERN ITERM_MSG_ERASE_CURSOR
 
 EXTERN zx_01_input_kbd_inkey
+IF USE_TYPE_AHEAD
+EXTERN _key_queue_get
+ELSE
 EXTERN zx_01_input_inkey_iterm_msg_getc
+ENDIF
 EXTERN l_jpix
 EXTERN _image_key_scroll
 EXTERN _cycle_text_color
 
-EXTERN _history_buffer_size
-EXTERN _edit_pressed
+EXTERN _history_typed
+EXTERN _history_typed_size
+EXTERN _history_key
+EXTERN _history_size
+IF USE_TILEMAP_TEXT
+EXTERN tile_01_output_char_custom_erase_input
+ENDIF
+IF USE_GFX
+EXTERN _gfx_on
+ENDIF
 
 defc ASCII_CODE_EDIT = 7
 defc ASCII_CODE_LEFT = 8
@@ -150,33 +170,80 @@ iterm_msg_getc:
    ;           carry set on error, hl = 0 (stream error) or -1 (eof)
    ; can use : af, bc, de, hl
 
+IF USE_TYPE_AHEAD
+   ; wait for the next key in the type-ahead keyboard queue
+   call _key_queue_get
+   ld a,l
+   ; a = ascii code
+ELSE
    ; call parent
    call zx_01_input_inkey_iterm_msg_getc
    ; a = ascii code
    ret c                       ; return if error
+ENDIF
    cp ASCII_CODE_EDIT
    jr z, history_check
+
+IF USE_GFX
+   ; up/down scroll the image if graphics is on
+   ld b,a
+   ld a,(_gfx_on)
+   or a
+   ld a,b
+   jr nz, not_history_key
+ENDIF
+
+   cp ASCII_CODE_UP
+   jr z, history_check
+
+   cp ASCII_CODE_DOWN
+   jr z, history_check
+
+not_history_key:
    or a                        ; clear carry flag
    ret
 
 history_check:
-   ; check if history buffer is empty
+   ; check if command history is empty
    ld b,a
-   ld de,(_history_buffer_size)
+   ld de,(_history_size)
    ld a,d
    or e
-   jr nz, signal_edit_pressed
+   jr nz, signal_history_key
    ld a,b
    or a                        ; clear carry flag
    ret
 
-signal_edit_pressed:
-   ; clear input terminal in preparation for calling program to insert history buffer
+signal_history_key:
+   ld a,b
+   ld (_history_key),a
+
+   ; copy the typed input to the history_typed buffer, the edit buffer
+   ; never contains more than 127 characters since the last index is
+   ; reserved for enter
+IF __SDCC_IY
+   ld l,(iy+19)
+   ld h,(iy+20)                ; hl = edit buffer data address
+   ld c,(iy+21)
+   ld b,(iy+22)                ; bc = edit buffer size
+ELSE
+   ld l,(ix+19)
+   ld h,(ix+20)                ; hl = edit buffer data address
+   ld c,(ix+21)
+   ld b,(ix+22)                ; bc = edit buffer size
+ENDIF
+   ld (_history_typed_size),bc
+   ld a,b
+   or c
+   jr z, typed_copied
+   ld de,(_history_typed)
+   ldir
+
+typed_copied:
+   ; clear input terminal in preparation for calling program to insert history entry
    call clear_input_terminal
 
-   ; signal that EDIT was pressed by setting edit_pressed variable and returning error
-   ld a,1
-   ld (_edit_pressed),a
+   ; signal that a history key was pressed by returning error
    ld hl,0
    scf
    ret
@@ -188,8 +255,9 @@ signal_edit_pressed:
 clear_input_terminal:
 
    ; Clear the input terminal; delete any typed characters on its connected
-   ; output terminal (an fzx output terminal) and empty the input terminal's
-   ; edit buffer.
+   ; output terminal (an fzx output terminal or, if USE_TILEMAP_TEXT is
+   ; enabled, a tilemap output terminal) and empty the input terminal's edit
+   ; buffer.
    ;
    ; enter   : ix = FDSTRUCT.JP *input_terminal
    ; exit    : none
@@ -221,6 +289,18 @@ ENDIF
    or e
    ret z
 
+IF USE_TILEMAP_TEXT
+
+   ; the tilemap output terminal has no edit position and no XOR mode so let it
+   ; erase the typed characters from the tilemap itself
+   push ix
+   push bc
+   pop ix                      ; ix = FDSTRUCT *output_terminal
+   call tile_01_output_char_custom_erase_input
+   pop ix                      ; ix = FDSTRUCT *input_terminal (if not __SDCC_IY)
+
+ELSE
+
 IF __SDCC_IY
    ld l,(iy+19)
    ld h,(iy+20)                ; hl = edit buffer data address
@@ -288,15 +368,18 @@ print_loop:
 
 IF __SDCC_IY
    pop iy                      ; ix = FDSTRUCT *input_terminal
+ELSE
+   pop ix                      ; ix = FDSTRUCT *input_terminal
+ENDIF
+
+ENDIF
 
    ; set input terminal's edit buffer size to 0
+IF __SDCC_IY
    ld a,0
    ld (iy+21),a
    ld (iy+22),a
 ELSE
-   pop ix                      ; ix = FDSTRUCT *input_terminal
-
-   ; set input terminal's edit buffer size to 0
    ld a,0
    ld (ix+21),a
    ld (ix+22),a
@@ -308,6 +391,8 @@ ENDIF
 ;; RESET_OUTPUT_TERMINAL_CURSOR
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
+IF USE_TILEMAP_TEXT = 0
+
 reset_output_terminal_cursor:
 
    ; Reset cursor position in output terminal to start of edit buffer's display
@@ -343,3 +428,5 @@ ELSE
 ENDIF
 
    ret
+
+ENDIF
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Implementation of image_archive.h.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "image_archive.h"
+
+#ifndef MAX_PATH
+#define MAX_PATH 256
+#endif
+
+static uint32_t file_length(FILE *f)
+{
+    uint32_t pos;
+    uint32_t file_size;
+
+    pos = ftell(f);
+    fseek(f, 0, SEEK_END);
+    file_size = ftell(f);
+    fseek(f, pos, SEEK_SET);
+    return file_size;
+}
+
+static void nxi_name(int num, const char *dir, char *out, size_t size)
+{
+    snprintf(out, size, "%s%d.nxi", dir, num);
+}
+
+static bool write_uint32(uint32_t value, FILE *f)
+{
+    uint8_t bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+
+    return fwrite(bytes, 1, sizeof(bytes), f) == sizeof(bytes);
+}
+
+static bool write_image(const char *nxi_filename, uint32_t size, FILE *archive_file, const char *archive_filename)
+{
+    FILE *nxi_file = fopen(nxi_filename, "rb");
+    uint8_t *data = malloc(size);
+    bool status = false;
+
+    if ((nxi_file == NULL) || (data == NULL) || (fread(data, 1, size, nxi_file) != size))
+    {
+        fprintf(stderr, "Error reading image file %s.\n", nxi_filename);
+    }
+    else if (fwrite(data, 1, size, archive_file) != size)
+    {
+        fprintf(stderr, "Error writing image data to file %s.\n", archive_filename);
+    }
+    else
+    {
+        status = true;
+    }
+
+    if (nxi_file != NULL)
+    {
+        fclose(nxi_file);
+    }
+    free(data);
+    return status;
+}
+
+bool create_image_archive(const char *dir)
+{
+    char archive_filename[MAX_PATH + 16];
+    char nxi_filename[MAX_PATH + 16];
+    uint32_t sizes[ARCHIVE_NUM_IMAGES];
+    uint32_t offset = ARCHIVE_NUM_IMAGES * 8;
+    int num_images = 0;
+
+    for (int i = 0; i < ARCHIVE_NUM_IMAGES; i++)
+    {
+        nxi_name(i, dir, nxi_filename, sizeof(nxi_filename));
+        FILE *nxi_file = fopen(nxi_filename, "rb");
+        sizes[i] = 0;
+        if (nxi_file != NULL)
+        {
+            sizes[i] = file_length(nxi_file);
+            fclose(nxi_file);
+        }
+    }
+
+    snprintf(archive_filename, sizeof(archive_filename), "%s%s", dir, IMAGE_ARCHIVE_FILE);
+    FILE *archive_file = fopen(archive_filename, "wb");
+    if (archive_file == NULL)
+    {
+        fprintf(stderr, "Error creating image archive file %s.\n", archive_filename);
+        return false;
+    }
+
+    for (int i = 0; i < ARCHIVE_NUM_IMAGES; i++)
+    {
+        if (!write_uint32((sizes[i] != 0) ? offset : 0, archive_file) || !write_uint32(sizes[i], archive_file))
+        {
+            fprintf(stderr, "Error writing to file %s.\n", archive_filename);
+            fclose(archive_file);
+            return false;
+        }
+        offset += sizes[i];
+    }
+
+    for (int i = 0; i < ARCHIVE_NUM_IMAGES; i++)
+    {
+        if (sizes[i] == 0)
+        {
+            continue;
+        }
+
+        nxi_name(i, dir, nxi_filename, sizeof(nxi_filename));
+        if (!write_image(nxi_filename, sizes[i], archive_file, archive_filename))
+        {
+            fclose(archive_file);
+            return false;
+        }
+        num_images++;
+    }
+
+    fclose(archive_file);
+
+    printf("Created image archive file %s with %d images\n", archive_filename, num_images);
+    return true;
+}
@@ -0,0 +1,33 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Image archive writer shared by the convert_gfx and convert_bitmap tools.
+ *
+ * An image archive packs the NXI image files of a game into a single file. The
+ * archive starts with a directory of 800 entries, one for each image number
+ * 0 - 799, containing the offset and size of the image in the archive as
+ * little-endian longs (both 0 if there is no such image). The directory is
+ * followed by the contents of the NXI image files. The interpreter keeps the
+ * archive open and seeks directly to an image instead of opening and closing a
+ * separate file for each image.
+ ******************************************************************************/
+
+#ifndef _IMAGE_ARCHIVE_H
+#define _IMAGE_ARCHIVE_H
+
+#include <stdbool.h>
+
+#define IMAGE_ARCHIVE_FILE "images.pak"
+
+// Number of entries in the directory of an image archive (images 0 - 799).
+#define ARCHIVE_NUM_IMAGES 800
+
+/*
+ * Pack the NXI image files <num>.nxi in the given directory, which must end
+ * with a path separator, into the image archive file images.pak in the same
+ * directory. Return false and print an error message to stderr if the archive
+ * could not be created.
+ */
+bool create_image_archive(const char *dir);
+
+#endif
@@ -17,6 +17,34 @@
  * will put the frame on all location pictures statically using this tool to
  * speed up the runtime handling of them. Picture #30 is skipped as location
  * picture since it's used as title picture on Atari ST.
+ *
+ * In batch mode, the games listed in a manifest file are converted in parallel
+ * by a pool of worker threads. Each line in the manifest file contains a game,
+ * its directory of bitmap files and optionally an output directory for its NXI
+ * files (defaults to the current directory). Empty lines and lines starting
+ * with '#' are ignored. The frame pictures (#1) of all games are converted
+ * first since the location pictures of a game are drawn inside its frame.
+ *
+ * The location pictures #2 and onwards only differ from each other inside the
+ * frame. They are therefore stored as inset images, which only contain the
+ * smallest rectangle inside the frame that covers all location pictures of the
+ * game. The interpreter loads the inset rectangle into a layer 2 screen that
+ * already holds the frame. An inset image file has the same name as an NXI
+ * image file but starts with a header that identifies it as an inset image:
+ *
+ * Bytes 0-3: The characters "NXIS".
+ * Bytes 4-5: Inset x position in pixels as a little-endian word.
+ * Byte 6: Inset y position in pixels.
+ * Bytes 7-8: Inset width in pixels as a little-endian word.
+ * Byte 9: Inset height in pixels.
+ * Bytes 10-521: NXI palette.
+ * Bytes 522-: Inset pixels stored column by column like in the NXI format.
+ *
+ * The second byte of an NXI palette entry only uses its lowest bit, so an NXI
+ * or 4-bit NXI image file can never start with the inset header.
+ *
+ * The NXI image files of a game are finally packed into an image archive file,
+ * images.pak, which the interpreter loads the images from if available.
  ******************************************************************************/
 
 #include <stdint.h>
@@ -26,6 +54,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <strings.h>
+#define stricmp strcasecmp
+#endif
+
+#include "image_archive.h"
 
 #ifndef MAX_PATH
 #define MAX_PATH 256
@@ -40,6 +80,13 @@
 
 #define PICTURE_HEIGHT 152
 
+#define MAX_GAMES 64
+
+#define MAX_PICTURES 100
+
+#define INSET_MAGIC "NXIS"
+#define INSET_HEADER_SIZE 10
+
 #define GAME_KNIGHT_ORC "knight-orc"
 #define GAME_GNOME_RANGER "gnome-ranger"
 #define GAME_TIME_AND_MAGIK "time-and-magik"
@@ -77,19 +124,65 @@ typedef struct
     uint16_t num_palette_colours;
 } Bitmap;
 
-static uint8_t nxi_palette[NXI_PALETTE_SIZE];
+typedef struct
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} Rect;
 
-static uint8_t nxi_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+typedef struct
+{
+    char name[MAX_PATH];
+    char dir[MAX_PATH];
+    char out_dir[MAX_PATH];
+    BitmapType type;
+    uint16_t picture_top_margin;
+    Rect inset;
+    uint8_t frame_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+} Game;
+
+typedef struct
+{
+    uint8_t palette[NXI_PALETTE_SIZE];
+    uint8_t image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+} Nxi;
+
+typedef struct
+{
+    Game *game;
+    int num;
+} Job;
+
+static Game *games[MAX_GAMES];
 
-static uint8_t nxi_frame_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+static int num_games = 0;
 
-static uint16_t picture_top_margin = 0;
+static Job *jobs = NULL;
+
+static int num_jobs = 0;
+
+static int next_job = 0;
+
+static int end_job = 0;
+
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool batch_mode = false;
+
+static bool batch_failed = false;
 
 static void print_usage(void)
 {
     printf("Usage: convert_bitmap <game> <directory>\n");
+    printf("       convert_bitmap -batch <manifest-file> [<num-threads>]\n");
     printf("Convert Level 9 bitmap files to ZX Spectrum Next format for a given game located in a given directory.\n");
-    printf("Only Amiga and Atari ST bitmap files are supported.\n");
+    printf("Only Amiga and Atari ST bitmap files are supported. The NXI images are also packed\n");
+    printf("into the image archive file " IMAGE_ARCHIVE_FILE ".\n");
+    printf("\n");
+    printf("In batch mode, each line of the manifest file contains <game> <directory> [<output-directory>]\n");
+    printf("and all games are converted in parallel using one thread per CPU core by default.\n");
     printf("\n");
     printf("The <game> argument can be one of:\n");
     printf(GAME_KNIGHT_ORC);
@@ -652,9 +745,46 @@ static Bitmap *bitmap_amiga_decode(char *file)
     return bitmap;
 }
 
-static void nxi_name(int num, char *out)
+static bool bitmap_size(char *dir, BitmapType type, int num, uint16_t *width, uint16_t *height)
 {
-    sprintf(out, "%d.nxi", num);
+    char file[MAX_PATH];
+    uint8_t data[72];
+    bool status = false;
+    FILE *f;
+
+    if (type == AMIGA_BITMAPS)
+    {
+        bitmap_amiga_name(num, dir, file);
+    }
+    else
+    {
+        bitmap_st_name(num, dir, file);
+    }
+
+    f = fopen(file, "rb");
+    if (f != NULL)
+    {
+        if ((type == AMIGA_BITMAPS) && (fread(data, 1, 72, f) == 72))
+        {
+            *width = data[67] + data[66] * 256;
+            *height = data[71] + data[70] * 256;
+            status = true;
+        }
+        else if ((type == ST_BITMAPS) && (fread(data, 1, 40, f) == 40))
+        {
+            *width = data[37] + data[36] * 256;
+            *height = data[39] + data[38] * 256;
+            status = true;
+        }
+        fclose(f);
+    }
+
+    return status;
+}
+
+static void nxi_name(int num, char *dir, char *out)
+{
+    sprintf(out, "%s%d.nxi", dir, num);
 }
 
 static uint8_t c8_to_c3(uint8_t c8, RoundingMode rounding_mode)
@@ -674,7 +804,7 @@ static uint8_t c8_to_c3(uint8_t c8, RoundingMode rounding_mode)
     }
 }
 
-static void create_nxi_palette(char *game, Bitmap *bitmap, BitmapType type, int num)
+static void create_nxi_palette(char *game, Bitmap *bitmap, BitmapType type, int num, uint8_t *nxi_palette)
 {
     RoundingMode rounding_mode = ROUND;
 
@@ -695,7 +825,7 @@ static void create_nxi_palette(char *game, Bitmap *bitmap, BitmapType type, int
         }
     }
 
-    memset(nxi_palette, 0, sizeof(nxi_palette));
+    memset(nxi_palette, 0, NXI_PALETTE_SIZE);
 
     // Create the NXI palette.
     // The RGB888 colors in the bitmap palette are converted to
@@ -794,33 +924,26 @@ static void get_bitmap_position(char *game, Bitmap *bitmap, int num, uint16_t *x
     }
 }
 
-static void create_nxi_image(char *game, Bitmap *bitmap, BitmapType type, int num)
+/*
+ * We want the frame picture and all following pictures to have a 2 pixel
+ * bottom margin and a top margin that makes their total height PICTURE_HEIGHT.
+ * The bottom margin is for having some space between the text and the
+ * picture and the top margin is to compensate for that not all monitors
+ * can display the full height of the layer 2 320x256 graphics mode.
+ */
+static uint16_t get_picture_top_margin(uint16_t frame_height)
+{
+    return PICTURE_HEIGHT - frame_height - 2;
+}
+
+static void get_picture_rect(Game *game, Bitmap *bitmap, int num, Rect *rect)
 {
     uint16_t x_start = 0;
     uint16_t y_start = 0;
     uint16_t width = bitmap->width;
     uint16_t height = bitmap->height;
-    uint8_t *image_ptr = bitmap->bitmap;
-
-    memset(nxi_image, 0, sizeof(nxi_image));
-    if (num > 1)
-    {
-        memcpy(nxi_image, nxi_frame_image, sizeof(nxi_frame_image));
-    }
 
-    get_bitmap_position(game, bitmap, num, &x_start, &y_start);
-
-    /*
-     * We want the frame picture and all following pictures to have a 2 pixel
-     * bottom margin and a top margin that makes their total height PICTURE_HEIGHT.
-     * The bottom margin is for having some space between the text and the
-     * picture and the top margin is to compensate for that not all monitors
-     * can display the full height of the layer 2 320x256 graphics mode.
-     */
-    if (num == 1)
-    {
-        picture_top_margin = PICTURE_HEIGHT - bitmap->height - 2;
-    }
+    get_bitmap_position(game->name, bitmap, num, &x_start, &y_start);
 
     /*
      * Hack for Amiga version of Knight Orc to fix that the pictures are four
@@ -828,7 +951,7 @@ static void create_nxi_image(char *game, Bitmap *bitmap, BitmapType type, int nu
      * repeated. The picture height is also reduced by one pixel to make them
      * fit better in the frame.
      */
-    if ((stricmp(game, GAME_KNIGHT_ORC) == 0) && (type == AMIGA_BITMAPS) && (num > 1))
+    if ((stricmp(game->name, GAME_KNIGHT_ORC) == 0) && (game->type == AMIGA_BITMAPS) && (num > 1))
     {
         width = width - 4;
         height = height - 1;
@@ -838,46 +961,101 @@ static void create_nxi_image(char *game, Bitmap *bitmap, BitmapType type, int nu
      * Hack for Amiga version of Gnome Ranger to reduce picture number five's
      * width by one pixel.
      */
-    if ((stricmp(game, GAME_GNOME_RANGER) == 0) && (type == AMIGA_BITMAPS) && (num == 5))
+    if ((stricmp(game->name, GAME_GNOME_RANGER) == 0) && (game->type == AMIGA_BITMAPS) && (num == 5))
     {
         width = width - 1;
     }
 
-    for (int y = 0; y < height; y++)
+    // The title picture has no top margin.
+    rect->x = x_start;
+    rect->y = ((num == 0) ? 0 : game->picture_top_margin) + y_start;
+    rect->width = width;
+    rect->height = height;
+}
+
+static void create_nxi_image(Game *game, Bitmap *bitmap, int num, uint8_t *nxi_image)
+{
+    uint8_t *image_ptr = bitmap->bitmap;
+    Rect rect;
+
+    memset(nxi_image, 0, NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT);
+    if (num > 1)
+    {
+        memcpy(nxi_image, game->frame_image, sizeof(game->frame_image));
+    }
+
+    if (num == 1)
     {
-        for (int x = 0; x < width; x++)
+        game->picture_top_margin = get_picture_top_margin(bitmap->height);
+    }
+
+    get_picture_rect(game, bitmap, num, &rect);
+
+    for (int y = 0; y < rect.height; y++)
+    {
+        for (int x = 0; x < rect.width; x++)
         {
-            nxi_image[(picture_top_margin + y_start + y) + (x_start + x) * NXI_IMAGE_HEIGHT] = image_ptr[x];
+            nxi_image[(rect.y + y) + (rect.x + x) * NXI_IMAGE_HEIGHT] = image_ptr[x];
         }
         image_ptr += bitmap->width;
     }
 
     if (num == 1)
     {
-        memcpy(nxi_frame_image, nxi_image, sizeof(nxi_image));
+        memcpy(game->frame_image, nxi_image, sizeof(game->frame_image));
     }
 }
 
-void convert_nxi(char *game, Bitmap *bitmap, BitmapType type, int num)
+void convert_nxi(Game *game, Bitmap *bitmap, int num, Nxi *nxi)
 {
-    char nxi_filename[MAX_PATH];
+    char nxi_filename[MAX_PATH + 16];
 
-    create_nxi_palette(game, bitmap, type, num);
-    create_nxi_image(game, bitmap, type, num);
+    create_nxi_palette(game->name, bitmap, game->type, num, nxi->palette);
+    create_nxi_image(game, bitmap, num, nxi->image);
 
-    nxi_name(num, nxi_filename);
+    nxi_name(num, game->out_dir, nxi_filename);
     FILE *nxi_file = fopen(nxi_filename, "wb");
     if (nxi_file == NULL)
     {
         exit_with_msg("Error creating image file %s.\n", nxi_filename);
     }
 
-    if (fwrite(nxi_palette, 1, sizeof(nxi_palette), nxi_file) != sizeof(nxi_palette))
+    bool is_inset = (num > 1) && (game->inset.width != 0);
+
+    if (is_inset)
+    {
+        Rect *inset = &game->inset;
+        uint8_t header[INSET_HEADER_SIZE] =
+        {
+            INSET_MAGIC[0], INSET_MAGIC[1], INSET_MAGIC[2], INSET_MAGIC[3],
+            inset->x & 0xFF, inset->x >> 8, inset->y, inset->width & 0xFF, inset->width >> 8, inset->height
+        };
+
+        if (fwrite(header, 1, sizeof(header), nxi_file) != sizeof(header))
+        {
+            exit_with_msg("Error writing inset header to file %s.\n", nxi_filename);
+        }
+    }
+
+    if (fwrite(nxi->palette, 1, sizeof(nxi->palette), nxi_file) != sizeof(nxi->palette))
     {
         exit_with_msg("Error writing palette to file %s.\n", nxi_filename);
     }
 
-    if (fwrite(nxi_image, 1, sizeof(nxi_image), nxi_file) != sizeof(nxi_image))
+    if (is_inset)
+    {
+        Rect *inset = &game->inset;
+
+        for (int x = inset->x; x < inset->x + inset->width; x++)
+        {
+            uint8_t *column = nxi->image + x * NXI_IMAGE_HEIGHT + inset->y;
+            if (fwrite(column, 1, inset->height, nxi_file) != inset->height)
+            {
+                exit_with_msg("Error writing image data to file %s.\n", nxi_filename);
+            }
+        }
+    }
+    else if (fwrite(nxi->image, 1, sizeof(nxi->image), nxi_file) != sizeof(nxi->image))
     {
         exit_with_msg("Error writing image data to file %s.\n", nxi_filename);
     }
@@ -942,53 +1120,318 @@ Bitmap *decode_bitmap(char *dir, BitmapType type, int num)
     }
 }
 
-int main(int argc, char *argv[])
+/*
+ * Compute the inset rectangle of the game, i.e. the smallest rectangle that
+ * covers all location pictures #2 and onwards, from the sizes of the bitmaps.
+ */
+static void compute_inset_rect(Game *game)
 {
-    char dir[MAX_PATH];
+    uint16_t width;
+    uint16_t height;
+    uint16_t x1 = NXI_IMAGE_WIDTH;
+    uint16_t y1 = NXI_IMAGE_HEIGHT;
+    uint16_t x2 = 0;
+    uint16_t y2 = 0;
+    Bitmap bitmap;
+    Rect rect;
 
-    if (argc <= 2)
+    memset(&game->inset, 0, sizeof(Rect));
+
+    // Without a frame picture, the location pictures are stored as is.
+    if (!exist_bitmap(game->dir, 1) || !bitmap_size(game->dir, game->type, 1, &width, &height))
     {
-        print_usage();
-        return 1;
+        return;
     }
 
-    char *game = argv[1];
-    char *path = argv[2];
+    game->picture_top_margin = get_picture_top_margin(height);
 
-    if (!validate_game(game))
+    for (int i = 2; i < MAX_PICTURES; i++)
     {
-        fprintf(stderr, "Unsupported game: %s\n", game);
-        return 1;
+        if (exist_bitmap(game->dir, i) && !is_st_title_bitmap(game->type, i) &&
+            bitmap_size(game->dir, game->type, i, &width, &height))
+        {
+            bitmap.width = width;
+            bitmap.height = height;
+            get_picture_rect(game, &bitmap, i, &rect);
+
+            x1 = (rect.x < x1) ? rect.x : x1;
+            y1 = (rect.y < y1) ? rect.y : y1;
+            x2 = (rect.x + rect.width > x2) ? rect.x + rect.width : x2;
+            y2 = (rect.y + rect.height > y2) ? rect.y + rect.height : y2;
+        }
     }
 
-    extend_dir_path(path, dir);
+    x2 = (x2 > NXI_IMAGE_WIDTH) ? NXI_IMAGE_WIDTH : x2;
+    y2 = (y2 > NXI_IMAGE_HEIGHT) ? NXI_IMAGE_HEIGHT : y2;
+
+    if ((x1 < x2) && (y1 < y2))
+    {
+        game->inset.x = x1;
+        game->inset.y = y1;
+        game->inset.width = x2 - x1;
+        game->inset.height = y2 - y1;
+    }
+}
 
-    BitmapType bitmap_type = detect_bitmaps(dir);
-    if (bitmap_type == NO_BITMAPS)
+bool convert_picture(Game *game, int num, Nxi *nxi)
+{
+    Bitmap *bitmap = decode_bitmap(game->dir, game->type, num);
+    if (bitmap == NULL)
+    {
+        fprintf(stderr, "Error decoding bitmap file %d of game %s.\n", num, game->name);
+        return false;
+    }
+
+    convert_nxi(game, bitmap, num, nxi);
+    if (batch_mode)
+    {
+        printf("Converted image %2.1d of %s (width: %d, height: %d)\n", num, game->name, bitmap->width, bitmap->height);
+    }
+    else
     {
-        fprintf(stderr, "Cannot find any bitmap files in directory %s\n", dir);
+        printf("Converted image %2.1d (width: %d, height: %d)\n", num, bitmap->width, bitmap->height);
+    }
+    free(bitmap);
+    return true;
+}
+
+static Game *create_game(char *name, char *path, char *out_path)
+{
+    if (!validate_game(name))
+    {
+        exit_with_msg("Unsupported game: %s\n", name);
+    }
+
+    Game *game = calloc(1, sizeof(Game));
+    if (game == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    strcpy(game->name, name);
+    extend_dir_path(path, game->dir);
+    if (out_path != NULL)
+    {
+        extend_dir_path(out_path, game->out_dir);
+    }
+
+    game->type = detect_bitmaps(game->dir);
+    if (game->type == NO_BITMAPS)
+    {
+        exit_with_msg("Cannot find any bitmap files in directory %s\n", game->dir);
+    }
+
+    compute_inset_rect(game);
+
+    return game;
+}
+
+static void read_manifest(char *manifest_file)
+{
+    char line[3 * MAX_PATH];
+    char name[MAX_PATH];
+    char path[MAX_PATH];
+    char out_path[MAX_PATH];
+
+    FILE *f = fopen(manifest_file, "r");
+    if (f == NULL)
+    {
+        exit_with_msg("Error opening manifest file %s.\n", manifest_file);
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        int num_fields = sscanf(line, "%255s %255s %255s", name, path, out_path);
+        if ((num_fields <= 0) || (name[0] == '#'))
+        {
+            continue;
+        }
+
+        if (num_fields < 2)
+        {
+            exit_with_msg("Missing directory for game %s in manifest file %s.\n", name, manifest_file);
+        }
+
+        if (num_games == MAX_GAMES)
+        {
+            exit_with_msg("Too many games in manifest file %s.\n", manifest_file);
+        }
+
+        games[num_games++] = create_game(name, path, (num_fields == 3) ? out_path : NULL);
+    }
+
+    fclose(f);
+
+    if (num_games == 0)
+    {
+        exit_with_msg("No games in manifest file %s.\n", manifest_file);
+    }
+}
+
+static void add_job(Game *game, int num)
+{
+    jobs[num_jobs].game = game;
+    jobs[num_jobs].num = num;
+    num_jobs++;
+}
+
+static void create_jobs(void)
+{
+    jobs = malloc(num_games * MAX_PICTURES * sizeof(Job));
+    if (jobs == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    // The frame pictures are converted first since the location pictures depend on them.
+    for (int g = 0; g < num_games; g++)
+    {
+        if (exist_bitmap(games[g]->dir, 1))
+        {
+            add_job(games[g], 1);
+        }
+    }
+
+    for (int g = 0; g < num_games; g++)
+    {
+        for (int i = 0; i < MAX_PICTURES; i++)
+        {
+            if ((i != 1) && exist_bitmap(games[g]->dir, i) && !is_st_title_bitmap(games[g]->type, i))
+            {
+                add_job(games[g], i);
+            }
+        }
+    }
+}
+
+static void *job_worker(void *arg)
+{
+    Nxi *nxi = malloc(sizeof(Nxi));
+    if (nxi == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    while (true)
+    {
+        Job *job = NULL;
+
+        pthread_mutex_lock(&job_mutex);
+        if (next_job < end_job)
+        {
+            job = &jobs[next_job++];
+        }
+        pthread_mutex_unlock(&job_mutex);
+
+        if (job == NULL)
+        {
+            break;
+        }
+
+        if (!convert_picture(job->game, job->num, nxi))
+        {
+            pthread_mutex_lock(&job_mutex);
+            batch_failed = true;
+            pthread_mutex_unlock(&job_mutex);
+        }
+    }
+
+    free(nxi);
+    return NULL;
+}
+
+static void run_jobs(int first_job, int last_job, int num_threads)
+{
+    pthread_t threads[num_threads];
+
+    next_job = first_job;
+    end_job = last_job;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, job_worker, NULL) != 0)
+        {
+            exit_with_msg("Error creating worker thread.\n");
+        }
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static int get_num_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+#else
+    return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static int convert_batch(char *manifest_file, int num_threads)
+{
+    int num_frame_jobs = 0;
+
+    batch_mode = true;
+    read_manifest(manifest_file);
+    create_jobs();
+
+    while ((num_frame_jobs < num_jobs) && (jobs[num_frame_jobs].num == 1))
+    {
+        num_frame_jobs++;
+    }
+
+    printf("Converting %d images of %d games using %d threads\n", num_jobs, num_games, num_threads);
+
+    run_jobs(0, num_frame_jobs, num_threads);
+    run_jobs(num_frame_jobs, num_jobs, num_threads);
+
+    for (int g = 0; g < num_games; g++)
+    {
+        if (!create_image_archive(games[g]->out_dir))
+        {
+            batch_failed = true;
+        }
+    }
+
+    return batch_failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static Nxi nxi;
+
+    if (argc <= 2)
+    {
+        print_usage();
         return 1;
     }
 
-    printf("Converting game %s located in directory %s\n", game, dir);
+    if (stricmp(argv[1], "-batch") == 0)
+    {
+        int num_threads = (argc > 3) ? atoi(argv[3]) : get_num_cores();
+        return convert_batch(argv[2], (num_threads > 0) ? num_threads : 1);
+    }
+
+    Game *game = create_game(argv[1], argv[2], NULL);
+
+    printf("Converting game %s located in directory %s\n", game->name, game->dir);
 
     // Picture numbers start at 0 and never exceeds 100.
-    for (int i = 0; i < 100; i++)
+    for (int i = 0; i < MAX_PICTURES; i++)
     {
-        if (exist_bitmap(dir, i) && !is_st_title_bitmap(bitmap_type, i))
+        if (exist_bitmap(game->dir, i) && !is_st_title_bitmap(game->type, i))
         {
-            Bitmap *bitmap = decode_bitmap(dir, bitmap_type, i);
-            if (bitmap == NULL)
+            if (!convert_picture(game, i, &nxi))
             {
-                fprintf(stderr, "Error decoding bitmap file %d.\n", i);
                 return 1;
             }
-
-            convert_nxi(game, bitmap, bitmap_type, i);
-            printf("Converted image %2.1d (width: %d, height: %d)\n", i, bitmap->width, bitmap->height);
-            free(bitmap);
         }
     }
 
-    return 0;
+    return create_image_archive(game->out_dir) ? 0 : 1;
 }
@@ -7,31 +7,78 @@
  * The routines for interpreting and drawing the pictures are based on the
  * level9.c and Lev9win.cpp files from the Level 9 interpreter.
  *
- * The tool uses an off-screen Windows bitmap for the Level 9 graphics
- * interpreter to draw the pictures on and another off-screen Windows bitmap for
- * stretching them to their final size. The stretched Windows bitmaps are then
- * converted to NXI images.
+ * The tool uses an in-memory 8-bit bitmap for the Level 9 graphics interpreter
+ * to draw the pictures on and another in-memory bitmap for stretching them to
+ * their final size. The stretched bitmaps are then converted to NXI images.
+ * The pixels in the bitmaps are indexes (0-3) into the Level 9 palette. The
+ * bitmaps and the palette are kept in a canvas, which is the OS-dependent
+ * drawing data of a graphics context. The palette is reset to black before
+ * each picture is drawn so that every picture is converted independently of
+ * the pictures converted before it.
+ *
+ * The tool also writes the graphics subroutines of the graphics file to a
+ * picture data file, gfx.dat, which is used by the interpreter for drawing the
+ * pictures at runtime when it's built with USE_LINE_GFX. The first byte of
+ * this file is the graphics type (0 = GFX_V2, 1 = GFX_V3A, 2 = GFX_V3B and
+ * 3 = GFX_V3C) followed by the graphics subroutines.
+ *
+ * If the -4bit option is given, the pictures are instead written as 4-bit NXI
+ * images, which is a variant of the NXI format with a palette of 16 colours
+ * (32 bytes) followed by the 320x256 pixels stored column by column with two
+ * 4-bit pixels per byte (high nibble first). Since a line-drawn picture never
+ * has more than 4 colours, a 4-bit NXI image has half the size of an NXI image
+ * and the interpreter expands it to 8 bits per pixel when loading it.
+ *
+ * The NXI image files are finally packed into an image archive file,
+ * images.pak, which the interpreter loads the images from if available.
+ *
+ * In batch mode, the graphics files listed in a manifest file are converted in
+ * parallel by a pool of worker threads, each with its own graphics context and
+ * canvas. Each line in the manifest file contains a graphics file, its graphics
+ * type and optionally an output directory for its NXI files and picture data
+ * file (defaults to the current directory). Empty lines and lines starting
+ * with '#' are ignored.
  ******************************************************************************/
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <strings.h>
+#define stricmp strcasecmp
+#endif
 
 #include "level9_gfx.h"
+#include "image_archive.h"
 
-#define H_WND_MAIN NULL
 #define L9_PALETTE_SIZE 4
 
 #define NXI_PALETTE_SIZE 512
 #define NXI_IMAGE_WIDTH 320
 #define NXI_IMAGE_HEIGHT 256
 
+#define NXI4_PALETTE_SIZE 32
+#define NXI4_IMAGE_SIZE (NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT / 2)
+
+#define PICTURE_DATA_FILE "gfx.dat"
+
+// The picture data must fit in the 64 KB picture data area of the interpreter.
+#define MAX_PICTURE_DATA_SIZE 0xFFFF
+
+// Maximum picture size of all graphics types.
+#define MAX_PIC_WIDTH 320
+#define MAX_PIC_HEIGHT 128
+
 /*
  * We want the pictures to have a 14 pixel top margin and a 2 pixel bottom
  * margin. The top margin is to compensate for that not all monitors can display
@@ -40,52 +87,101 @@
  */
 #define PICTURE_TOP_MARGIN 14
 
+// Initial size of the stack of pixel spans to be filled by os_fill(). The stack
+// is doubled in size whenever it is full.
+#define FILL_STACK_SIZE 4096
+
+/*
+ * It seems that all complete pictures use graphics subroutines in the range
+ * 500 to 800, although not all consecutive numbers in this range are used.
+ * The graphics subroutines below 500 seem to be for sub-images.
+ */
+#define FIRST_PICTURE 500
+#define END_PICTURE 800
+
+#define MAX_GAMES 64
+
+typedef struct
+{
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+} Colour;
+
 typedef struct
 {
-    BITMAPINFOHEADER bmi_header;
-    RGBQUAD bmi_colors[L9_PALETTE_SIZE];
-} L9_BITMAPINFO;
+    int16_t x1;
+    int16_t x2;
+    int16_t y;
+    int16_t dy;
+} FillSpan;
 
-// Context for drawing the picture in its original size.
-static HDC h_dc = NULL;
-static HBITMAP h_bitmap = NULL;
-static uint8_t *pixels = NULL;
-static int pic_width = 0;
-static int pic_height = 0;
+typedef struct
+{
+    // Bitmap for drawing the picture in its original size.
+    uint8_t pixels[MAX_PIC_WIDTH * MAX_PIC_HEIGHT];
+    int pic_width;
+    int pic_height;
 
-// Context for stretching the picture to its final size.
-static HDC h_draw_dc = NULL;
-static HBITMAP h_draw_bitmap = NULL;
-static uint8_t *draw_pixels = NULL;
-static int draw_pic_width = 0;
-static int draw_pic_height = 0;
+    // Bitmap for stretching the picture to its final size.
+    uint8_t draw_pixels[MAX_PIC_WIDTH * MAX_PIC_HEIGHT];
+    int draw_pic_width;
+    int draw_pic_height;
 
-// The Level 9 colour table is slightly changed to fit Spectrum Next better.
-static RGBQUAD colours[8] =
-{
-    { 0x00, 0x00, 0x00, 0 }, // Black
-    { 0x00, 0x00, 0xFF, 0 }, // Red
-    { 0x24, 0xDB, 0x24, 0 }, // Green
-    { 0x00, 0xFF, 0xFF, 0 }, // Yellow
-    { 0xFF, 0x00, 0x00, 0 }, // Blue
-    { 0x00, 0x6D, 0x92, 0 }, // Brown
-    { 0xFF, 0xFF, 0x00, 0 }, // Cyan
-    { 0xFF, 0xFF, 0xFF, 0 }  // White
-};
+    Colour palette[L9_PALETTE_SIZE];
+
+    FillSpan *fill_stack;
+    int fill_stack_size;
+
+    uint8_t nxi_palette[NXI_PALETTE_SIZE];
+    uint8_t nxi_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+} Canvas;
+
+typedef struct
+{
+    char filename[MAX_PATH];
+    char type_name[MAX_PATH];
+    char out_dir[MAX_PATH];
+    GfxTypes type;
+    GfxFile gfx;
+} Game;
 
-static RGBQUAD palette[L9_PALETTE_SIZE] =
+typedef struct
+{
+    Game *game;
+    int num;
+} Job;
+
+// The Level 9 colour table is slightly changed to fit Spectrum Next better.
+static const Colour colours[8] =
 {
-    { 0x00, 0x00, 0x00, 0 },
-    { 0x00, 0x00, 0x00, 0 },
-    { 0x00, 0x00, 0x00, 0 },
-    { 0x00, 0x00, 0x00, 0 }
+    { 0x00, 0x00, 0x00 }, // Black
+    { 0xFF, 0x00, 0x00 }, // Red
+    { 0x24, 0xDB, 0x24 }, // Green
+    { 0xFF, 0xFF, 0x00 }, // Yellow
+    { 0x00, 0x00, 0xFF }, // Blue
+    { 0x92, 0x6D, 0x00 }, // Brown
+    { 0x00, 0xFF, 0xFF }, // Cyan
+    { 0xFF, 0xFF, 0xFF }  // White
 };
 
-static COLORREF line_colour1 = 0;
-static COLORREF line_colour2 = 0;
+static Game *games[MAX_GAMES];
+
+static int num_games = 0;
+
+static Job *jobs = NULL;
+
+static int num_jobs = 0;
+
+static int next_job = 0;
+
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static uint8_t nxi_palette[NXI_PALETTE_SIZE];
-static uint8_t nxi_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
+static bool batch_mode = false;
+
+static bool create_nxi = true;
+
+static bool create_nxi4 = false;
 
 /*******************************************************************************
  * Helper Functions
@@ -93,9 +189,19 @@ static uint8_t nxi_image[NXI_IMAGE_WIDTH * NXI_IMAGE_HEIGHT];
 
 static void print_usage(void)
 {
-    printf("Usage: convert_gfx <graphics-file> [<graphics-type>]\n");
+    printf("Usage: convert_gfx [-nonxi] [-4bit] <graphics-file> [<graphics-type>]\n");
+    printf("       convert_gfx [-nonxi] [-4bit] -batch <manifest-file> [<num-threads>]\n");
     printf("Convert the pictures in a Level 9 graphics file of the given type to ZX Spectrum Next format.\n");
     printf("\n");
+    printf("The pictures are converted to NXI images and the graphics subroutines are written\n");
+    printf("to the picture data file " PICTURE_DATA_FILE ". If the -nonxi option is given, only\n");
+    printf("the picture data file is written. The NXI images are also packed into the image\n");
+    printf("archive file " IMAGE_ARCHIVE_FILE ". If the -4bit option is given, the pictures are\n");
+    printf("converted to 4-bit NXI images of half the size.\n");
+    printf("\n");
+    printf("In batch mode, each line of the manifest file contains <graphics-file> <graphics-type> [<output-directory>]\n");
+    printf("and all graphics files are converted in parallel using one thread per CPU core by default.\n");
+    printf("\n");
     printf("The <graphics-type> argument can be one of:\n");
     printf("GFX_V2");
     printf("\n");
@@ -117,21 +223,16 @@ static void exit_with_msg(const char* format, ...)
     exit(1);
 }
 
-static void get_dir(char *path)
+static void extend_dir_path(char *dir, char *out)
 {
-    char *dir;
-
-    dir = strrchr(path, '\\');
-    if (dir == NULL)
+    strcpy(out, dir);
+    int length = strlen(out);
+    if ((out[length - 1] != '/') && (out[length - 1] != '\\'))
     {
-        dir = strrchr(path, '/');
-        if (dir == NULL)
-        {
-            dir = path;
-        }
+        // Windows supports '/' as path separator nowadays.
+        out[length] = '/';
+        out[length + 1] = '\0';
     }
-
-    *dir = '\0';
 }
 
 static GfxTypes get_gfx_type(char *type)
@@ -158,100 +259,46 @@ static GfxTypes get_gfx_type(char *type)
     }
 }
 
-/*
- * The set_index_palette() function sets the palette for a Windows bitmap with
- * four distinct RGB colours that are based on the four palette index values 0-3.
- *
- * The corresponding get_index_colour() function retrieves the RGB colour with
- * the given index from the palette of a Windows bitmap.
- *
- * The palette for a Windows bitmap is set when the bitmap is created and then
- * stays constant. Note that the actual RGB colours in the Windows bitmap palette
- * are not important in this case. The only important property is that they are
- * distinct. The actual colours used by the final picture is in the palette
- * managed by the os_set_colour() function. That palette can be updated while
- * a picture is being drawn.
- */
-
-static void set_index_palette(RGBQUAD *pal)
-{
-    for (int i = 0; i < L9_PALETTE_SIZE; i++)
-    {
-        pal[i].rgbBlue = 8 * i;
-        pal[i].rgbGreen = 8 * i;
-        pal[i].rgbRed = 8 * i;
-        pal[i].rgbReserved = 0;
-    }
-}
-
-// index: 0-3
-static COLORREF get_index_colour(int index)
-{
-    int i = 8 * index;
-    return RGB(i, i, i);
-}
-
-static void create_bitmap_info(L9_BITMAPINFO *bitmap_info, int width, int height)
-{
-    // Create info for an 8 bits-per-pixel top-down bitmap.
-    memset(bitmap_info, 0, sizeof(L9_BITMAPINFO));
-    bitmap_info->bmi_header.biSize = sizeof(BITMAPINFOHEADER);
-    bitmap_info->bmi_header.biPlanes = 1;
-    bitmap_info->bmi_header.biBitCount = 8;
-    bitmap_info->bmi_header.biCompression = BI_RGB;
-    bitmap_info->bmi_header.biWidth = width;
-    bitmap_info->bmi_header.biHeight = height * -1;
-    bitmap_info->bmi_header.biClrUsed = L9_PALETTE_SIZE;
-    bitmap_info->bmi_header.biClrImportant = L9_PALETTE_SIZE;
-    set_index_palette(bitmap_info->bmi_colors);
-}
-
-static bool is_blank_picture()
+static bool is_blank_picture(Canvas *canvas)
 {
-    uint8_t *image_ptr = pixels;
+    uint8_t *image_ptr = canvas->pixels;
     uint8_t first_pixel = *image_ptr;
 
-    for (int y = 0; y < pic_height; y++)
+    for (int y = 0; y < canvas->pic_height; y++)
     {
-        for (int x = 0; x < pic_width; x++)
+        for (int x = 0; x < canvas->pic_width; x++)
         {
             if (image_ptr[x] != first_pixel)
             {
                 return false;
             }
         }
-        image_ptr += pic_width;
+        image_ptr += canvas->pic_width;
     }
 
     return true;
 }
 
-static void draw_picture(void)
-{
-    RECT rect;
-    rect.left = 0;
-    rect.right = draw_pic_width;
-    rect.top = 0;
-    rect.bottom = draw_pic_height;
-    FillRect(h_draw_dc, &rect, (HBRUSH) GetStockObject(BLACK_BRUSH));
-
-    // Blit and (if needed) stretch the picture to its final size.
-    StretchBlt(h_draw_dc, 0, 0, draw_pic_width, draw_pic_height,
-        h_dc, 0, 0, pic_width, pic_height, SRCCOPY);
-}
-
-static void free_resources(void)
+static void draw_picture(Canvas *canvas)
 {
-    DeleteObject(h_bitmap);
-    DeleteDC(h_dc);
+    uint8_t *src_ptr = canvas->pixels;
+    uint8_t *dst_ptr = canvas->draw_pixels;
 
-    DeleteObject(h_draw_bitmap);
-    DeleteDC(h_draw_dc);
+    // Copy and (if needed) stretch the picture to its final size.
+    for (int y = 0; y < canvas->draw_pic_height; y++)
+    {
+        for (int x = 0; x < canvas->draw_pic_width; x++)
+        {
+            dst_ptr[x] = src_ptr[(x * canvas->pic_width) / canvas->draw_pic_width];
+        }
+        src_ptr += canvas->pic_width;
+        dst_ptr += canvas->draw_pic_width;
+    }
 }
 
-static void nxi_name(int num, char *out)
+static void nxi_name(int num, char *dir, char *out, size_t size)
 {
-    sprintf(out, "%d.nxi", num);
+    snprintf(out, size, "%s%d.nxi", dir, num);
 }
 
 static uint8_t c8_to_c3(uint8_t c8)
@@ -259,71 +306,102 @@ static uint8_t c8_to_c3(uint8_t c8)
     return (uint8_t) round((c8 * 7.0) / 255.0);
 }
 
-static void create_nxi_palette(void)
+static void create_nxi_palette(Canvas *canvas)
 {
-    memset(nxi_palette, 0, sizeof(nxi_palette));
+    memset(canvas->nxi_palette, 0, sizeof(canvas->nxi_palette));
 
-    // The RGB888 colors in the Windows bitmap palette are converted
-    // to RGB333 colors, which are then split in RGB332 and B1 parts.
+    // The RGB888 colors in the Level 9 palette are converted to
+    // RGB333 colors, which are then split in RGB332 and B1 parts.
     for (int i = 0; i < L9_PALETTE_SIZE; i++)
     {
-        RGBQUAD *colour = &(palette[i]);
+        Colour *colour = &(canvas->palette[i]);
 
-        uint8_t r3 = c8_to_c3(colour->rgbRed);
-        uint8_t g3 = c8_to_c3(colour->rgbGreen);
-        uint8_t b3 = c8_to_c3(colour->rgbBlue);
+        uint8_t r3 = c8_to_c3(colour->red);
+        uint8_t g3 = c8_to_c3(colour->green);
+        uint8_t b3 = c8_to_c3(colour->blue);
 
         uint16_t rgb333 = (r3 << 6) | (g3 << 3) | (b3 << 0);
         uint8_t rgb332 = (uint8_t) (rgb333 >> 1);
         uint8_t b1 = (uint8_t) (rgb333 & 0x01);
 
-        nxi_palette[i * 2 + 0] = rgb332;
-        nxi_palette[i * 2 + 1] = b1;
+        canvas->nxi_palette[i * 2 + 0] = rgb332;
+        canvas->nxi_palette[i * 2 + 1] = b1;
     }
 }
 
-static void create_nxi_image(void)
+static void create_nxi_image(Canvas *canvas)
 {
-    uint8_t *image_ptr = draw_pixels;
+    uint8_t *image_ptr = canvas->draw_pixels;
 
     /*
      * We want the unused parts of the image to be black. Since black is not
      * guaranteed to be included in the 4 colour Level 9 palette, we choose
      * one of the other 252 colours in the layer 2 palette, which are all
-     * initilaized to black.
+     * initilaized to black. For 4-bit NXI images, we choose the last of the
+     * 16 colours in the palette.
      */
-    memset(nxi_image, 255, sizeof(nxi_image));
+    memset(canvas->nxi_image, create_nxi4 ? 15 : 255, sizeof(canvas->nxi_image));
+
+    for (int y = 0; y < canvas->draw_pic_height; y++)
+    {
+        for (int x = 0; x < canvas->draw_pic_width; x++)
+        {
+            canvas->nxi_image[(PICTURE_TOP_MARGIN + y) + x * NXI_IMAGE_HEIGHT] = image_ptr[x];
+        }
+        image_ptr += canvas->draw_pic_width;
+    }
+}
+
+static void write_nxi4(Canvas *canvas, FILE *nxi_file, char *nxi_filename)
+{
+    uint8_t *image_ptr = canvas->nxi_image;
 
-    for (int y = 0; y < draw_pic_height; y++)
+    // The first 16 colours of the NXI palette, the rest are unused.
+    if (fwrite(canvas->nxi_palette, 1, NXI4_PALETTE_SIZE, nxi_file) != NXI4_PALETTE_SIZE)
     {
-        for (int x = 0; x < draw_pic_width; x++)
+        exit_with_msg("Error writing palette to file %s.\n", nxi_filename);
+    }
+
+    // Pack two consecutive pixels of a column in one byte, the first one in the high nibble.
+    for (int i = 0; i < NXI4_IMAGE_SIZE; i++)
+    {
+        uint8_t packed = (uint8_t) ((image_ptr[0] << 4) | image_ptr[1]);
+        image_ptr += 2;
+
+        if (fputc(packed, nxi_file) == EOF)
         {
-            nxi_image[(PICTURE_TOP_MARGIN + y) + x * NXI_IMAGE_HEIGHT] = image_ptr[x];
+            exit_with_msg("Error writing image data to file %s.\n", nxi_filename);
         }
-        image_ptr += draw_pic_width;
     }
 }
 
-static void convert_nxi(int num)
+static void convert_nxi(Game *game, int num, Canvas *canvas)
 {
-    char nxi_filename[MAX_PATH];
+    char nxi_filename[MAX_PATH + 16];
 
-    create_nxi_palette();
-    create_nxi_image();
+    create_nxi_palette(canvas);
+    create_nxi_image(canvas);
 
-    nxi_name(num, nxi_filename);
+    nxi_name(num, game->out_dir, nxi_filename, sizeof(nxi_filename));
     FILE *nxi_file = fopen(nxi_filename, "wb");
     if (nxi_file == NULL)
     {
         exit_with_msg("Error creating image file %s.\n", nxi_filename);
     }
 
-    if (fwrite(nxi_palette, 1, sizeof(nxi_palette), nxi_file) != sizeof(nxi_palette))
+    if (create_nxi4)
+    {
+        write_nxi4(canvas, nxi_file, nxi_filename);
+        fclose(nxi_file);
+        return;
+    }
+
+    if (fwrite(canvas->nxi_palette, 1, sizeof(canvas->nxi_palette), nxi_file) != sizeof(canvas->nxi_palette))
     {
         exit_with_msg("Error writing palette to file %s.\n", nxi_filename);
     }
 
-    if (fwrite(nxi_image, 1, sizeof(nxi_image), nxi_file) != sizeof(nxi_image))
+    if (fwrite(canvas->nxi_image, 1, sizeof(canvas->nxi_image), nxi_file) != sizeof(canvas->nxi_image))
     {
         exit_with_msg("Error writing image data to file %s.\n", nxi_filename);
     }
@@ -331,98 +409,268 @@ static void convert_nxi(int num)
     fclose(nxi_file);
 }
 
+static void convert_picture_data(Game *game)
+{
+    char data_filename[MAX_PATH + 16];
+    uint8_t *data;
+    uint32_t size;
+    uint8_t type = (uint8_t) game->type;
+
+    if (!get_picture_data(&game->gfx, &data, &size))
+    {
+        exit_with_msg("No picture data to write.\n");
+    }
+
+    if (size + 1 > MAX_PICTURE_DATA_SIZE)
+    {
+        exit_with_msg("Picture data is too large (%u bytes).\n", size);
+    }
+
+    snprintf(data_filename, sizeof(data_filename), "%s%s", game->out_dir, PICTURE_DATA_FILE);
+    FILE *data_file = fopen(data_filename, "wb");
+    if (data_file == NULL)
+    {
+        exit_with_msg("Error creating picture data file %s.\n", data_filename);
+    }
+
+    if ((fwrite(&type, 1, 1, data_file) != 1) || (fwrite(data, 1, size, data_file) != size))
+    {
+        exit_with_msg("Error writing picture data to file %s.\n", data_filename);
+    }
+
+    fclose(data_file);
+
+    printf("Created picture data file %s\n", data_filename);
+}
+
+static Canvas *create_canvas(void)
+{
+    Canvas *canvas = calloc(1, sizeof(Canvas));
+    if (canvas == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    canvas->fill_stack = malloc(FILL_STACK_SIZE * sizeof(FillSpan));
+    if (canvas->fill_stack == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+    canvas->fill_stack_size = FILL_STACK_SIZE;
+    return canvas;
+}
+
+static void free_canvas(Canvas *canvas)
+{
+    free(canvas->fill_stack);
+    free(canvas);
+}
+
 /*******************************************************************************
  * Graphics Routines
  ******************************************************************************/
 
-void os_init_graphics(void)
+static void plot(Canvas *canvas, int x, int y, int colour1, int colour2)
+{
+    if ((x >= 0) && (x < canvas->pic_width) && (y >= 0) && (y < canvas->pic_height))
+    {
+        uint8_t *pixel = canvas->pixels + y * canvas->pic_width + x;
+        if (*pixel == colour2)
+        {
+            *pixel = colour1;
+        }
+    }
+}
+
+static void push_fill_span(Canvas *canvas, int *sp, int x1, int x2, int y, int dy)
 {
-    // Setup context for drawing the picture in its original size.
+    if ((y + dy >= 0) && (y + dy < canvas->pic_height))
+    {
+        FillSpan *span;
+
+        if (*sp == canvas->fill_stack_size)
+        {
+            int new_size = canvas->fill_stack_size * 2;
+            FillSpan *new_stack = realloc(canvas->fill_stack, new_size * sizeof(FillSpan));
+            if (new_stack == NULL)
+            {
+                exit_with_msg("Out of memory.\n");
+            }
+            canvas->fill_stack = new_stack;
+            canvas->fill_stack_size = new_size;
+        }
 
-    HDC h_dc_main = GetDC(H_WND_MAIN);
-    h_dc = CreateCompatibleDC(h_dc_main);
-    ReleaseDC(H_WND_MAIN, h_dc_main);
+        span = &canvas->fill_stack[(*sp)++];
+        span->x1 = x1;
+        span->x2 = x2;
+        span->y = y;
+        span->dy = dy;
+    }
+}
 
-    get_picture_size(&pic_width, &pic_height);
+void os_init_graphics(GfxContext *ctx)
+{
+    Canvas *canvas = (Canvas *) ctx->os_data;
 
-    L9_BITMAPINFO bitmap_info;
-    create_bitmap_info(&bitmap_info, pic_width, pic_height);
+    // Setup bitmap for drawing the picture in its original size.
 
-    h_bitmap = CreateDIBSection(h_dc, (BITMAPINFO *) &bitmap_info,
-        DIB_RGB_COLORS, (VOID **) &pixels, NULL, 0);
-    SelectObject(h_dc, h_bitmap);
+    get_picture_size(ctx->file, &canvas->pic_width, &canvas->pic_height);
 
-    // Setup context for stretching the picture to its final size.
+    // Setup bitmap for stretching the picture to its final size.
 
-    draw_pic_width = pic_width;
-    draw_pic_height = pic_height;
+    canvas->draw_pic_width = canvas->pic_width;
+    canvas->draw_pic_height = canvas->pic_height;
 
     // Widen GFX_V2/GFX_V3A/GFX_V3B pictures from 160 to 320 pixels (as used by GFX_V3C).
-    if (draw_pic_width < 320)
+    if (canvas->draw_pic_width < 320)
     {
-        draw_pic_width = 320;
+        canvas->draw_pic_width = 320;
     }
-
-    h_draw_dc = CreateCompatibleDC(h_dc);
-    SetStretchBltMode(h_draw_dc, COLORONCOLOR);
-
-    L9_BITMAPINFO draw_bitmap_info;
-    create_bitmap_info(&draw_bitmap_info, draw_pic_width, draw_pic_height);
-
-    h_draw_bitmap = CreateDIBSection(h_draw_dc, (BITMAPINFO *) &draw_bitmap_info,
-        DIB_RGB_COLORS, (VOID **) &draw_pixels, NULL, 0);
-    SelectObject(h_draw_dc, h_draw_bitmap);
 }
 
-void os_clear_graphics(void)
+void os_clear_graphics(GfxContext *ctx)
 {
-    RECT rect;
-    rect.left = 0;
-    rect.right = pic_width;
-    rect.top = 0;
-    rect.bottom = pic_height;
+    Canvas *canvas = (Canvas *) ctx->os_data;
 
-    HBRUSH brush = CreateSolidBrush(get_index_colour(0));
-    HGDIOBJ old = SelectObject(h_dc, brush);
-    FillRect(h_dc, &rect, brush);
-    SelectObject(h_dc, old);
-    DeleteObject(brush);
+    memset(canvas->pixels, 0, canvas->pic_width * canvas->pic_height);
+    memset(canvas->palette, 0, sizeof(canvas->palette));
 }
 
 // colour: 0-3, index: 0-7
-void os_set_colour(int colour, int index)
+void os_set_colour(GfxContext *ctx, int colour, int index)
 {
-    palette[colour] = colours[index];
+    Canvas *canvas = (Canvas *) ctx->os_data;
+
+    canvas->palette[colour] = colours[index];
 }
 
-void CALLBACK line_proc(int x, int y, LPARAM p)
+/*
+ * Draw a line with the Bresenham algorithm, including both end points, in the
+ * same way as the Windows LineDDA() function previously used by this tool.
+ * Only the pixels having colour2 are set to colour1.
+ */
+// colour: 0-3
+void os_draw_line(GfxContext *ctx, int x1, int y1, int x2, int y2, int colour1, int colour2)
 {
-    if (GetPixel(h_dc, x, y) == line_colour2)
+    Canvas *canvas = (Canvas *) ctx->os_data;
+    int x = x1;
+    int y = y1;
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int x_add = (x2 < x1) ? -1 : 1;
+    int y_add = (y2 < y1) ? -1 : 1;
+    int err;
+
+    if (dx > dy)
+    {
+        err = 2 * dy - dx;
+        for (int i = 0; i < dx; i++)
+        {
+            plot(canvas, x, y, colour1, colour2);
+            if (err > 0)
+            {
+                y += y_add;
+                err += 2 * dy - 2 * dx;
+            }
+            else
+            {
+                err += 2 * dy;
+            }
+            x += x_add;
+        }
+    }
+    else
     {
-        SetPixel(h_dc, x, y, line_colour1);
+        err = 2 * dx - dy;
+        for (int i = 0; i < dy; i++)
+        {
+            plot(canvas, x, y, colour1, colour2);
+            if (err > 0)
+            {
+                x += x_add;
+                err += 2 * dx - 2 * dy;
+            }
+            else
+            {
+                err += 2 * dx;
+            }
+            y += y_add;
+        }
     }
-}
 
-// colour: 0-3
-void os_draw_line(int x1, int y1, int x2, int y2, int colour1, int colour2)
-{
-    line_colour1 = get_index_colour(colour1);
-    line_colour2 = get_index_colour(colour2);
-    LineDDA(x1, y1, x2, y2, line_proc, (LPARAM) NULL);
-    line_proc(x2, y2, (LPARAM) NULL);
+    plot(canvas, x2, y2, colour1, colour2);
 }
 
+/*
+ * Fill the 4-connected area of colour2 pixels containing the given point with
+ * colour1 using a scanline span fill. Each stacked span is a range of pixels
+ * on the line above or below an already filled span that should be examined.
+ */
 // colour: 0-3
-void os_fill(int x, int y, int colour1, int colour2)
+void os_fill(GfxContext *ctx, int x, int y, int colour1, int colour2)
 {
-    COLORREF colour = get_index_colour(colour2);
-    if (GetPixel(h_dc, x, y) == colour)
+    Canvas *canvas = (Canvas *) ctx->os_data;
+    int pic_width = canvas->pic_width;
+    int sp = 0;
+
+    if ((x < 0) || (x >= pic_width) || (y < 0) || (y >= canvas->pic_height) ||
+        (canvas->pixels[y * pic_width + x] != colour2) || (colour1 == colour2))
     {
-        HBRUSH brush = CreateSolidBrush(get_index_colour(colour1));
-        HGDIOBJ old = SelectObject(h_dc, brush);
-        ExtFloodFill(h_dc, x, y, colour, FLOODFILLSURFACE);
-        SelectObject(h_dc, old);
-        DeleteObject(brush);
+        return;
+    }
+
+    push_fill_span(canvas, &sp, x, x, y, 1);
+    push_fill_span(canvas, &sp, x, x, y + 1, -1);
+
+    while (sp > 0)
+    {
+        FillSpan *span = &canvas->fill_stack[--sp];
+        int x1 = span->x1;
+        int x2 = span->x2;
+        int dy = span->dy;
+        int left;
+        uint8_t *line;
+
+        y = span->y + dy;
+        line = canvas->pixels + y * pic_width;
+
+        // Extend the span to the left of x1.
+        for (x = x1; (x >= 0) && (line[x] == colour2); x--)
+        {
+            line[x] = colour1;
+        }
+
+        if (x >= x1)
+        {
+            goto skip;
+        }
+
+        left = x + 1;
+        if (left < x1)
+        {
+            // Leak in the opposite direction to the left of the parent span.
+            push_fill_span(canvas, &sp, left, x1 - 1, y, -dy);
+        }
+        x = x1 + 1;
+
+        do
+        {
+            for (; (x < pic_width) && (line[x] == colour2); x++)
+            {
+                line[x] = colour1;
+            }
+
+            push_fill_span(canvas, &sp, left, x - 1, y, dy);
+            if (x > x2 + 1)
+            {
+                // Leak in the opposite direction to the right of the parent span.
+                push_fill_span(canvas, &sp, x2 + 1, x - 1, y, -dy);
+            }
+skip:
+            for (x++; (x <= x2) && (line[x] != colour2); x++);
+            left = x;
+        }
+        while (x <= x2);
     }
 }
 
@@ -430,60 +678,293 @@ void os_fill(int x, int y, int colour1, int colour2)
  * Main
  ******************************************************************************/
 
-int main(int argc, char *argv[])
+static void convert_picture(GfxContext *ctx, Game *game, int num)
 {
-    char *filename;
-    char *type;
-    char dir[MAX_PATH];
-    GfxTypes gfx_type;
+    Canvas *canvas = (Canvas *) ctx->os_data;
 
-    if (argc < 2)
+    if (!show_picture(ctx, num))
     {
-        print_usage();
-        return 1;
+        return;
     }
 
-    filename = argv[1];
-    type = (argc > 2) ? argv[2] : "GFX_V3C";
+    while (run_graphics(ctx));
 
-    strcpy(dir, filename);
-    get_dir(dir);
+    if (!is_blank_picture(canvas))
+    {
+        draw_picture(canvas);
+        convert_nxi(game, num, canvas);
+        if (batch_mode)
+        {
+            printf("Converted picture %d of %s\n", num, game->filename);
+        }
+        else
+        {
+            printf("Converted picture %d\n", num);
+        }
+    }
+}
 
-    gfx_type = get_gfx_type(type);
-    if (gfx_type == GFX_UNKNOWN)
+static Game *create_game(char *filename, char *type, char *out_path)
+{
+    Game *game = calloc(1, sizeof(Game));
+    if (game == NULL)
     {
-        fprintf(stderr, "Error: Unknown graphics type %s.\n", type);
-        return 1;
+        exit_with_msg("Out of memory.\n");
     }
 
-    if (!load_graphics(filename, gfx_type))
+    strcpy(game->filename, filename);
+    strcpy(game->type_name, type);
+    if (out_path != NULL)
     {
-        fprintf(stderr, "Error: Unable to load graphics file %s.\n", filename);
-        return 1;
+        extend_dir_path(out_path, game->out_dir);
     }
 
-    printf("Converting graphics file %s of type %s\n", filename, type);
+    game->type = get_gfx_type(type);
+    if (game->type == GFX_UNKNOWN)
+    {
+        exit_with_msg("Error: Unknown graphics type %s.\n", type);
+    }
 
-    /*
-     * It seems that all complete pictures use graphics subroutines in the range
-     * 500 to 800, although not all consecutive numbers in this range are used.
-     * The graphics subroutines below 500 seem to be for sub-images.
-     */
-    for (int i = 500; i < 800; i++)
+    if (!load_graphics(&game->gfx, filename, game->type))
+    {
+        exit_with_msg("Error: Unable to load graphics file %s.\n", filename);
+    }
+
+    printf("Converting graphics file %s of type %s\n", game->filename, game->type_name);
+
+    convert_picture_data(game);
+
+    return game;
+}
+
+static void read_manifest(char *manifest_file)
+{
+    char line[3 * MAX_PATH];
+    char filename[MAX_PATH];
+    char type[MAX_PATH];
+    char out_path[MAX_PATH];
+
+    FILE *f = fopen(manifest_file, "r");
+    if (f == NULL)
+    {
+        exit_with_msg("Error opening manifest file %s.\n", manifest_file);
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        int num_fields = sscanf(line, "%255s %255s %255s", filename, type, out_path);
+        if ((num_fields <= 0) || (filename[0] == '#'))
+        {
+            continue;
+        }
+
+        if (num_fields < 2)
+        {
+            exit_with_msg("Missing graphics type for graphics file %s in manifest file %s.\n", filename, manifest_file);
+        }
+
+        if (num_games == MAX_GAMES)
+        {
+            exit_with_msg("Too many graphics files in manifest file %s.\n", manifest_file);
+        }
+
+        games[num_games++] = create_game(filename, type, (num_fields == 3) ? out_path : NULL);
+    }
+
+    fclose(f);
+
+    if (num_games == 0)
+    {
+        exit_with_msg("No graphics files in manifest file %s.\n", manifest_file);
+    }
+}
+
+static void create_jobs(void)
+{
+    jobs = malloc(num_games * (END_PICTURE - FIRST_PICTURE) * sizeof(Job));
+    if (jobs == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    for (int g = 0; g < num_games; g++)
     {
-        if (show_picture(i))
+        for (int i = FIRST_PICTURE; i < END_PICTURE; i++)
         {
-            while (run_graphics());
-            if (!is_blank_picture())
+            jobs[num_jobs].game = games[g];
+            jobs[num_jobs].num = i;
+            num_jobs++;
+        }
+    }
+}
+
+static void *job_worker(void *arg)
+{
+    Canvas *canvas = create_canvas();
+    GfxContext ctx;
+
+    ctx.file = NULL;
+
+    while (true)
+    {
+        Job *job = NULL;
+
+        pthread_mutex_lock(&job_mutex);
+        if (next_job < num_jobs)
+        {
+            job = &jobs[next_job++];
+        }
+        pthread_mutex_unlock(&job_mutex);
+
+        if (job == NULL)
+        {
+            break;
+        }
+
+        // The graphics context is reused for all pictures of the same game.
+        if (ctx.file != &job->game->gfx)
+        {
+            init_graphics_context(&ctx, &job->game->gfx, canvas);
+        }
+
+        convert_picture(&ctx, job->game, job->num);
+    }
+
+    free_canvas(canvas);
+    return NULL;
+}
+
+static void run_jobs(int num_threads)
+{
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+
+    if (threads == NULL)
+    {
+        exit_with_msg("Out of memory.\n");
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, job_worker, NULL) != 0)
+        {
+            exit_with_msg("Error creating worker thread.\n");
+        }
+    }
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+static int get_num_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+#else
+    return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static int convert_batch(char *manifest_file, int num_threads)
+{
+    int status = 0;
+
+    batch_mode = true;
+    read_manifest(manifest_file);
+
+    if (create_nxi)
+    {
+        create_jobs();
+
+        printf("Converting pictures %d to %d of %d graphics files using %d threads\n",
+            FIRST_PICTURE, END_PICTURE - 1, num_games, num_threads);
+
+        run_jobs(num_threads);
+
+        for (int g = 0; g < num_games; g++)
+        {
+            if (!create_image_archive(games[g]->out_dir))
             {
-                draw_picture();
-                convert_nxi(i);
-                printf("Converted picture %d\n", i);
+                status = 1;
             }
         }
     }
 
-    free_memory();
-    free_resources();
-    return 0;
+    for (int g = 0; g < num_games; g++)
+    {
+        free_memory(&games[g]->gfx);
+    }
+
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int status = 0;
+
+    while ((argc > 1) && (argv[1][0] == '-') && (stricmp(argv[1], "-batch") != 0))
+    {
+        if (strcmp(argv[1], "-nonxi") == 0)
+        {
+            create_nxi = false;
+        }
+        else if (strcmp(argv[1], "-4bit") == 0)
+        {
+            create_nxi4 = true;
+        }
+        else
+        {
+            print_usage();
+            return 1;
+        }
+        argc--;
+        argv++;
+    }
+
+    if (argc < 2)
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (stricmp(argv[1], "-batch") == 0)
+    {
+        if (argc < 3)
+        {
+            print_usage();
+            return 1;
+        }
+
+        int num_threads = (argc > 3) ? atoi(argv[3]) : get_num_cores();
+        return convert_batch(argv[2], (num_threads > 0) ? num_threads : 1);
+    }
+
+    Game *game = create_game(argv[1], (argc > 2) ? argv[2] : "GFX_V3C", NULL);
+
+    if (create_nxi)
+    {
+        Canvas *canvas = create_canvas();
+        GfxContext ctx;
+
+        init_graphics_context(&ctx, &game->gfx, canvas);
+
+        for (int i = FIRST_PICTURE; i < END_PICTURE; i++)
+        {
+            convert_picture(&ctx, game, i);
+        }
+
+        free_canvas(canvas);
+        if (!create_image_archive(game->out_dir))
+        {
+            status = 1;
+        }
+    }
+
+    free_memory(&game->gfx);
+    return status;
 }
@@ -11,11 +11,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "level9_gfx.h"
 
-#define GFX_STACK_SIZE 100
-
 /*
  * Graphics type    Resolution     Scale stack reset
  * -------------------------------------------------
@@ -25,26 +24,6 @@
  * GFX_V3C          320 x 96             no
  */
 
-static uint8_t *picture_address = NULL;
-static uint8_t *picture_data = NULL;
-static uint32_t picture_size;
-static GfxTypes gfx_mode = GFX_V2;
-
-static uint8_t *gfx_a5 = NULL;
-
-static int reflect_flag;
-static int scale;
-static int colour;
-static int option;
-static int draw_x = 0;
-static int draw_y = 0;
-
-static uint8_t *gfx_a5_stack[GFX_STACK_SIZE];
-static int gfx_a5_stack_pos = 0;
-
-static int gfx_scale_stack[GFX_STACK_SIZE];
-static int gfx_scale_stack_pos = 0;
-
 /******************************************************************************
  * Helper Functions
  *****************************************************************************/
@@ -155,100 +134,108 @@ static bool find_gfx_subs(uint8_t *test_ptr, uint32_t test_size, uint8_t **pic_d
     return false;
 }
 
-static bool valid_gfx_ptr(uint8_t *ptr)
+static bool valid_gfx_ptr(const GfxFile *file, uint8_t *ptr)
 {
-    return (ptr >= picture_data) && (ptr < picture_data + picture_size);
+    return (ptr >= file->picture_data) && (ptr < file->picture_data + file->picture_size);
 }
 
 /*
- * Find the graphics subroutine with number d0 and return its address in a5 if found.
+ * Build the table of graphics subroutine addresses by traversing the graphics
+ * subroutines once. If there are several subroutines with the same number, the
+ * first one is used.
  */
-static bool find_gfx_sub(int d0, uint8_t **a5)
+static void build_gfx_sub_table(GfxFile *file)
 {
-    int d1;
-    int d2;
+    int d0;
     int d3;
     int d4;
+    uint8_t *a5 = file->picture_data;
 
-    d1 = d0 << 4;
-    d2 = d1 >> 8;
-    *a5 = picture_data;
+    memset(file->gfx_sub_table, 0, sizeof(file->gfx_sub_table));
 
     while (true)
     {
-        d3 = *(*a5)++;
-        if (!valid_gfx_ptr(*a5))
-        {
-            return false;
-        }
-        if (d3 & 0x80)
+        d3 = *a5++;
+        if (!valid_gfx_ptr(file, a5) || (d3 & 0x80))
         {
-            return false;
+            return;
         }
-        if (d2 == d3)
+
+        d0 = (d3 << 4) | (*a5 >> 4);
+        if (file->gfx_sub_table[d0] == NULL)
         {
-            if ((d1 & 0xff) == (*(*a5) & 0xf0))
-            {
-                (*a5) += 2;
-                return true;
-            }
+            file->gfx_sub_table[d0] = a5 + 2;
         }
 
-        d3 = *(*a5)++ & 0x0f;
-        if (!valid_gfx_ptr(*a5))
+        d3 = *a5++ & 0x0f;
+        if (!valid_gfx_ptr(file, a5))
         {
-            return false;
+            return;
         }
 
-        d4 = **a5;
+        d4 = *a5;
         if ((d3 | d4) == 0)
         {
-            return false;
+            return;
         }
 
-        (*a5) += (d3 << 8) + d4 - 2;
-        if (!valid_gfx_ptr(*a5))
+        a5 += (d3 << 8) + d4 - 2;
+        if (!valid_gfx_ptr(file, a5))
         {
-            return false;
+            return;
         }
     }
 }
 
-static void gosub_d0(int d0, uint8_t **a5)
+/*
+ * Find the graphics subroutine with number d0 and return its address in a5 if found.
+ */
+static bool find_gfx_sub(const GfxFile *file, int d0, uint8_t **a5)
+{
+    if ((d0 < 0) || (d0 >= NUM_GFX_SUBS) || (file->gfx_sub_table[d0] == NULL))
+    {
+        return false;
+    }
+
+    *a5 = file->gfx_sub_table[d0];
+    return true;
+}
+
+static void gosub_d0(GfxContext *ctx, int d0, uint8_t **a5)
 {
-    if (gfx_a5_stack_pos < GFX_STACK_SIZE)
+    if (ctx->gfx_a5_stack_pos < GFX_STACK_SIZE)
     {
-        gfx_a5_stack[gfx_a5_stack_pos] = *a5;
-        gfx_a5_stack_pos++;
+        ctx->gfx_a5_stack[ctx->gfx_a5_stack_pos] = *a5;
+        ctx->gfx_a5_stack_pos++;
 
-        gfx_scale_stack[gfx_scale_stack_pos] = scale;
-        gfx_scale_stack_pos++;
+        ctx->gfx_scale_stack[ctx->gfx_scale_stack_pos] = ctx->scale;
+        ctx->gfx_scale_stack_pos++;
 
-        if (!find_gfx_sub(d0, a5))
+        if (!find_gfx_sub(ctx->file, d0, a5))
         {
-            gfx_a5_stack_pos--;
-            *a5 = gfx_a5_stack[gfx_a5_stack_pos];
+            ctx->gfx_a5_stack_pos--;
+            *a5 = ctx->gfx_a5_stack[ctx->gfx_a5_stack_pos];
 
-            gfx_scale_stack_pos--;
-            scale = gfx_scale_stack[gfx_scale_stack_pos];
+            ctx->gfx_scale_stack_pos--;
+            ctx->scale = ctx->gfx_scale_stack[ctx->gfx_scale_stack_pos];
         }
     }
 }
 
-static int scale_x(int x)
+static int scale_x(GfxContext *ctx, int x)
 {
-    return (gfx_mode != GFX_V3C) ? (x >> 6) : (x >> 5);
+    return (ctx->file->gfx_mode != GFX_V3C) ? (x >> 6) : (x >> 5);
 }
 
-static int scale_y(int y)
+static int scale_y(GfxContext *ctx, int y)
 {
-    return (gfx_mode == GFX_V2) ? 127 - (y >> 7) : 95 - (((y >> 5) + (y >> 6)) >> 3);
+    return (ctx->file->gfx_mode == GFX_V2) ? 127 - (y >> 7) : 95 - (((y >> 5) + (y >> 6)) >> 3);
 }
 
-static void new_xy(int x, int y)
+static void new_xy(GfxContext *ctx, int x, int y)
 {
-    draw_x += (x * scale) & ~7;
-    draw_y += (y * scale) & ~7;
+    ctx->draw_x += (x * ctx->scale) & ~7;
+    ctx->draw_y += (y * ctx->scale) & ~7;
 }
 
 /******************************************************************************
@@ -262,7 +249,7 @@ static void new_xy(int x, int y)
  *     x is x argument, high bit is sign
  *     y is y argument, high bit is sign
  */
-static void sdraw(int d7)
+static void sdraw(GfxContext *ctx, int d7)
 {
     int x;
     int y;
@@ -281,21 +268,21 @@ static void sdraw(int d7)
         y = (y | 0xf0) - 0x100;
     }
 
-    if (reflect_flag & 2)
+    if (ctx->reflect_flag & 2)
     {
         x = -x;
     }
 
-    if (reflect_flag & 1)
+    if (ctx->reflect_flag & 1)
     {
         y = -y;
     }
 
-    x1 = draw_x;
-    y1 = draw_y;
-    new_xy(x, y);
+    x1 = ctx->draw_x;
+    y1 = ctx->draw_y;
+    new_xy(ctx, x, y);
 
-    os_draw_line(scale_x(x1), scale_y(y1), scale_x(draw_x), scale_y(draw_y), colour & 3, option & 3);
+    os_draw_line(ctx, scale_x(ctx, x1), scale_y(ctx, y1), scale_x(ctx, ctx->draw_x), scale_y(ctx, ctx->draw_y), ctx->colour & 3, ctx->option & 3);
 }
 
 /* smove instruction plus arguments are stored in an 8-bit word.
@@ -305,7 +292,7 @@ static void sdraw(int d7)
  *     x is x argument, high bit is sign
  *     y is y argument, high bit is sign
  */
-static void smove(int d7)
+static void smove(GfxContext *ctx, int d7)
 {
     int x;
     int y;
@@ -322,23 +309,23 @@ static void smove(int d7)
         y = (y | 0xf0) - 0x100;
     }
 
-    if (reflect_flag & 2)
+    if (ctx->reflect_flag & 2)
     {
         x = -x;
     }
 
-    if (reflect_flag & 1)
+    if (ctx->reflect_flag & 1)
     {
         y = -y;
     }
 
-    new_xy(x, y);
+    new_xy(ctx, x, y);
 }
 
-static void sgosub(int d7, uint8_t **a5)
+static void sgosub(GfxContext *ctx, int d7, uint8_t **a5)
 {
     int d0 = d7 & 0x3f;
-    gosub_d0(d0, a5);
+    gosub_d0(ctx, d0, a5);
 }
 
 /* draw instruction plus arguments are stored in a 16-bit word.
@@ -348,7 +335,7 @@ static void sgosub(int d7, uint8_t **a5)
  *     x is x argument, high bit is sign
  *     y is y argument, high bit is sign
  */
-static void draw(int d7, uint8_t **a5)
+static void draw(GfxContext *ctx, int d7, uint8_t **a5)
 {
     int xy;
     int x;
@@ -370,21 +357,21 @@ static void draw(int d7, uint8_t **a5)
         y = (y | 0xc0) - 0x100;
     }
 
-    if (reflect_flag & 2)
+    if (ctx->reflect_flag & 2)
     {
         x = -x;
     }
 
-    if (reflect_flag & 1)
+    if (ctx->reflect_flag & 1)
     {
         y = -y;
     }
 
-    x1 = draw_x;
-    y1 = draw_y;
-    new_xy(x, y);
+    x1 = ctx->draw_x;
+    y1 = ctx->draw_y;
+    new_xy(ctx, x, y);
 
-    os_draw_line(scale_x(x1), scale_y(y1), scale_x(draw_x), scale_y(draw_y), colour & 3, option & 3);
+    os_draw_line(ctx, scale_x(ctx, x1), scale_y(ctx, y1), scale_x(ctx, ctx->draw_x), scale_y(ctx, ctx->draw_y), ctx->colour & 3, ctx->option & 3);
 }
 
 /* move instruction plus arguments are stored in a 16-bit word.
@@ -394,7 +381,7 @@ static void draw(int d7, uint8_t **a5)
  *     x is x argument, high bit is sign
  *     y is y argument, high bit is sign
  */
-static void move(int d7, uint8_t **a5)
+static void move(GfxContext *ctx, int d7, uint8_t **a5)
 {
     int xy;
     int x;
@@ -414,25 +401,25 @@ static void move(int d7, uint8_t **a5)
         y = (y | 0xc0) - 0x100;
     }
 
-    if (reflect_flag & 2)
+    if (ctx->reflect_flag & 2)
     {
         x = -x;
     }
 
-    if (reflect_flag & 1)
+    if (ctx->reflect_flag & 1)
     {
         y = -y;
     }
 
-    new_xy(x, y);
+    new_xy(ctx, x, y);
 }
 
-static void icolour(int d7)
+static void icolour(GfxContext *ctx, int d7)
 {
-    colour = d7 & 3;
+    ctx->colour = d7 & 3;
 }
 
-static void size(int d7)
+static void size(GfxContext *ctx, int d7)
 {
     static int size_table[7] = { 0x02, 0x04, 0x06, 0x07, 0x09, 0x0c, 0x10 };
 
@@ -440,26 +427,26 @@ static void size(int d7)
 
     if (d7)
     {
-        int d0 = (scale * size_table[d7 - 1]) >> 3;
-        scale = (d0 < 0x100) ? d0 : 0xff;
+        int d0 = (ctx->scale * size_table[d7 - 1]) >> 3;
+        ctx->scale = (d0 < 0x100) ? d0 : 0xff;
     }
     else
     {
         /* size reset */
-        scale = 0x80;
-        if (gfx_mode == GFX_V2 || gfx_mode == GFX_V3A)
+        ctx->scale = 0x80;
+        if (ctx->file->gfx_mode == GFX_V2 || ctx->file->gfx_mode == GFX_V3A)
         {
-            gfx_scale_stack_pos = 0;
+            ctx->gfx_scale_stack_pos = 0;
         }
     }
 }
 
-static void fill(int d7)
+static void fill(GfxContext *ctx, int d7)
 {
     if ((d7 & 7) == 0)
     {
         /* fill_a */
-        d7 = colour;
+        d7 = ctx->colour;
     }
     else
     {
@@ -467,24 +454,24 @@ static void fill(int d7)
         d7 &= 3;
     }
 
-    os_fill(scale_x(draw_x), scale_y(draw_y), d7 & 3, option & 3);
+    os_fill(ctx, scale_x(ctx, ctx->draw_x), scale_y(ctx, ctx->draw_y), d7 & 3, ctx->option & 3);
 }
 
-static void gosub(int d7, uint8_t **a5)
+static void gosub(GfxContext *ctx, int d7, uint8_t **a5)
 {
     int d0 = ((d7 & 7) << 8) + (*(*a5)++);
-    gosub_d0(d0, a5);
+    gosub_d0(ctx, d0, a5);
 }
 
-static void reflect(int d7)
+static void reflect(GfxContext *ctx, int d7)
 {
     if (d7 & 4)
     {
         d7 &= 3;
-        d7 ^= reflect_flag;
+        d7 ^= ctx->reflect_flag;
     }
 
-    reflect_flag = d7;
+    ctx->reflect_flag = d7;
 }
 
 static void not_imp(void)
@@ -492,19 +479,19 @@ static void not_imp(void)
     // Not implemented
 }
 
-static void change_colour(uint8_t **a5)
+static void change_colour(GfxContext *ctx, uint8_t **a5)
 {
     int d0 = *(*a5)++;
-    os_set_colour((d0 >> 3) & 3, d0 & 7);
+    os_set_colour(ctx, (d0 >> 3) & 3, d0 & 7);
 }
 
-static void amove(uint8_t **a5)
+static void amove(GfxContext *ctx, uint8_t **a5)
 {
-    draw_x = 0x40 * (*(*a5)++);
-    draw_y = 0x40 * (*(*a5)++);
+    ctx->draw_x = 0x40 * (*(*a5)++);
+    ctx->draw_y = 0x40 * (*(*a5)++);
 }
 
-static void opt(uint8_t **a5)
+static void opt(GfxContext *ctx, uint8_t **a5)
 {
     int d0 = *(*a5)++;
 
@@ -513,28 +500,28 @@ static void opt(uint8_t **a5)
         d0 = (d0 & 3) | 0x80;
     }
 
-    option = d0;
+    ctx->option = d0;
 }
 
-static void restore_scale(void)
+static void restore_scale(GfxContext *ctx)
 {
-    if (gfx_scale_stack_pos > 0)
+    if (ctx->gfx_scale_stack_pos > 0)
     {
-        scale = gfx_scale_stack[gfx_scale_stack_pos - 1];
+        ctx->scale = ctx->gfx_scale_stack[ctx->gfx_scale_stack_pos - 1];
     }
 }
 
-static bool rts(uint8_t **a5)
+static bool rts(GfxContext *ctx, uint8_t **a5)
 {
-    if (gfx_a5_stack_pos > 0)
+    if (ctx->gfx_a5_stack_pos > 0)
     {
-        gfx_a5_stack_pos--;
-        *a5 = gfx_a5_stack[gfx_a5_stack_pos];
+        ctx->gfx_a5_stack_pos--;
+        *a5 = ctx->gfx_a5_stack[ctx->gfx_a5_stack_pos];
 
-        if (gfx_scale_stack_pos > 0)
+        if (ctx->gfx_scale_stack_pos > 0)
         {
-            gfx_scale_stack_pos--;
-            scale = gfx_scale_stack[gfx_scale_stack_pos];
+            ctx->gfx_scale_stack_pos--;
+            ctx->scale = ctx->gfx_scale_stack[ctx->gfx_scale_stack_pos];
         }
 
         return true;
@@ -543,7 +530,7 @@ static bool rts(uint8_t **a5)
     return false;
 }
 
-static bool run_instruction(uint8_t **a5)
+static bool run_instruction(GfxContext *ctx, uint8_t **a5)
 {
     int d7 = *(*a5)++;
 
@@ -551,22 +538,22 @@ static bool run_instruction(uint8_t **a5)
     {
         switch ((d7 >> 6) & 3)
         {
-            case 0: sdraw(d7); break;
-            case 1: smove(d7); break;
-            case 2: sgosub(d7, a5); break;
+            case 0: sdraw(ctx, d7); break;
+            case 1: smove(ctx, d7); break;
+            case 2: sgosub(ctx, d7, a5); break;
         }
     }
     else if ((d7 & 0x38) != 0x38)
     {
         switch ((d7 >> 3) & 7)
         {
-            case 0: draw(d7, a5); break;
-            case 1: move(d7, a5); break;
-            case 2: icolour(d7); break;
-            case 3: size(d7); break;
-            case 4: fill(d7); break;
-            case 5: gosub(d7, a5); break;
-            case 6: reflect(d7); break;
+            case 0: draw(ctx, d7, a5); break;
+            case 1: move(ctx, d7, a5); break;
+            case 2: icolour(ctx, d7); break;
+            case 3: size(ctx, d7); break;
+            case 4: fill(ctx, d7); break;
+            case 5: gosub(ctx, d7, a5); break;
+            case 6: reflect(ctx, d7); break;
         }
     }
     else
@@ -574,45 +561,44 @@ static bool run_instruction(uint8_t **a5)
         switch (d7 & 7)
         {
             case 0: not_imp(); break;
-            case 1: change_colour(a5); break;
+            case 1: change_colour(ctx, a5); break;
             case 2: not_imp(); break;
-            case 3: amove(a5); break;
-            case 4: opt(a5); break;
-            case 5: restore_scale(); break;
+            case 3: amove(ctx, a5); break;
+            case 4: opt(ctx, a5); break;
+            case 5: restore_scale(ctx); break;
             case 6: not_imp(); break;
-            case 7: return rts(a5);
+            case 7: return rts(ctx, a5);
         }
     }
 
     return true;
 }
 
-static void abs_run_gfx_sub(int d0)
+static void abs_run_gfx_sub(GfxContext *ctx, int d0)
 {
     uint8_t *a5;
 
-    if (!find_gfx_sub(d0, &a5))
+    if (!find_gfx_sub(ctx->file, d0, &a5))
     {
         return;
     }
 
-    while (run_instruction(&a5));
+    while (run_instruction(ctx, &a5));
 }
 
 /******************************************************************************
  * Public Functions
  *****************************************************************************/
 
-bool load_graphics(char *filename, GfxTypes gfx_type)
+bool load_graphics(GfxFile *file, char *filename, GfxTypes gfx_type)
 {
     FILE *f;
 
-    picture_address = NULL;
-    picture_data = NULL;
-    picture_size = 0;
+    file->picture_address = NULL;
+    file->picture_data = NULL;
+    file->picture_size = 0;
 
-    gfx_mode = gfx_type;
-    gfx_a5 = NULL;
+    file->gfx_mode = gfx_type;
 
     f = fopen(filename, "rb");
     if (f == NULL)
@@ -621,83 +607,104 @@ bool load_graphics(char *filename, GfxTypes gfx_type)
         return false;
     }
 
-    picture_size = file_length(f);
-    picture_address = malloc(picture_size);
-    if (picture_address == NULL)
+    file->picture_size = file_length(f);
+    file->picture_address = malloc(file->picture_size);
+    if (file->picture_address == NULL)
     {
         fclose(f);
         fprintf(stderr, "Unable to allocate memory for graphics file.\n");
         return false;
     }
 
-    if (fread(picture_address, 1, picture_size, f) != picture_size)
+    if (fread(file->picture_address, 1, file->picture_size, f) != file->picture_size)
     {
-        free(picture_address);
+        free(file->picture_address);
         fclose(f);
         fprintf(stderr, "Error reading graphics file.\n");
         return false;
     }
     fclose(f);
 
-    if (!find_gfx_subs(picture_address, picture_size, &picture_data, &picture_size))
+    if (!find_gfx_subs(file->picture_address, file->picture_size, &file->picture_data, &file->picture_size))
     {
-        free(picture_address);
+        free(file->picture_address);
         fprintf(stderr, "Error processing graphics file.\n");
         return false;
     }
 
-    os_init_graphics();
+    build_gfx_sub_table(file);
 
     return true;
 }
 
-void get_picture_size(int *width, int *height)
+void get_picture_size(const GfxFile *file, int *width, int *height)
 {
     if (width != NULL)
     {
-        *width = (gfx_mode != GFX_V3C) ? 160 : 320;
+        *width = (file->gfx_mode != GFX_V3C) ? 160 : 320;
     }
 
     if (height != NULL)
     {
-        *height = (gfx_mode == GFX_V2) ? 128 : 96;
+        *height = (file->gfx_mode == GFX_V2) ? 128 : 96;
+    }
+}
+
+bool get_picture_data(const GfxFile *file, uint8_t **data, uint32_t *size)
+{
+    if (file->picture_data == NULL)
+    {
+        return false;
     }
+
+    *data = file->picture_data;
+    *size = file->picture_size;
+    return true;
+}
+
+void init_graphics_context(GfxContext *ctx, const GfxFile *file, void *os_data)
+{
+    memset(ctx, 0, sizeof(GfxContext));
+    ctx->file = file;
+    ctx->os_data = os_data;
+
+    os_init_graphics(ctx);
 }
 
-bool show_picture(int pic)
+bool show_picture(GfxContext *ctx, int pic)
 {
-    os_clear_graphics();
+    os_clear_graphics(ctx);
 
-    reflect_flag = 0;
-    scale = 0x80;
-    colour = 3;
-    option = 0x80;
-    draw_x = 0x1400;
-    draw_y = 0x1400;
+    ctx->reflect_flag = 0;
+    ctx->scale = 0x80;
+    ctx->colour = 3;
+    ctx->option = 0x80;
+    ctx->draw_x = 0x1400;
+    ctx->draw_y = 0x1400;
 
-    gfx_a5_stack_pos = 0;
-    gfx_scale_stack_pos = 0;
+    ctx->gfx_a5_stack_pos = 0;
+    ctx->gfx_scale_stack_pos = 0;
 
     // Run graphics subroutine #0.
-    abs_run_gfx_sub(0);
+    abs_run_gfx_sub(ctx, 0);
 
     // Find graphics subroutine #pic.
-    if (!find_gfx_sub(pic, &gfx_a5))
+    if (!find_gfx_sub(ctx->file, pic, &ctx->gfx_a5))
     {
-        gfx_a5 = NULL;
+        ctx->gfx_a5 = NULL;
         return false;
     }
 
     return true;
 }
 
-bool run_graphics(void)
+bool run_graphics(GfxContext *ctx)
 {
-    if (gfx_a5)
+    if (ctx->gfx_a5)
     {
-        if (!run_instruction(&gfx_a5))
+        if (!run_instruction(ctx, &ctx->gfx_a5))
         {
-            gfx_a5 = NULL;
+            ctx->gfx_a5 = NULL;
         }
 
         return true;
@@ -706,11 +713,11 @@ bool run_graphics(void)
     return false;
 }
 
-void free_memory(void)
+void free_memory(GfxFile *file)
 {
-    if (picture_address)
+    if (file->picture_address)
     {
-        free(picture_address);
-        picture_address = NULL;
+        free(file->picture_address);
+        file->picture_address = NULL;
     }
 }
@@ -3,14 +3,26 @@
  *
  * Routines for interpreting and drawing the pictures in a Level 9 graphics file.
  * Based on the level9.h file from the Level 9 interpreter.
+ *
+ * A loaded graphics file (GfxFile) is read-only and can be shared by several
+ * graphics contexts (GfxContext). Each graphics context contains the state of
+ * the graphics interpreter for drawing one picture at a time, which makes it
+ * possible to draw several pictures in parallel using one graphics context per
+ * thread.
  ******************************************************************************/
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifndef MAX_PATH
 #define MAX_PATH 256
 #endif
 
+#define GFX_STACK_SIZE 100
+
+// Number of graphics subroutines (0x000 - 0x7ff).
+#define NUM_GFX_SUBS 2048
+
 typedef enum
 {
     GFX_V2,
@@ -20,6 +32,40 @@ typedef enum
     GFX_UNKNOWN
 } GfxTypes;
 
+typedef struct
+{
+    uint8_t *picture_address;
+    uint8_t *picture_data;
+    uint32_t picture_size;
+    GfxTypes gfx_mode;
+
+    // Address of each graphics subroutine, NULL if the subroutine doesn't exist.
+    uint8_t *gfx_sub_table[NUM_GFX_SUBS];
+} GfxFile;
+
+typedef struct
+{
+    const GfxFile *file;
+
+    // Drawing data owned by the OS-dependent code.
+    void *os_data;
+
+    uint8_t *gfx_a5;
+
+    int reflect_flag;
+    int scale;
+    int colour;
+    int option;
+    int draw_x;
+    int draw_y;
+
+    uint8_t *gfx_a5_stack[GFX_STACK_SIZE];
+    int gfx_a5_stack_pos;
+
+    int gfx_scale_stack[GFX_STACK_SIZE];
+    int gfx_scale_stack_pos;
+} GfxContext;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,29 +74,33 @@ extern "C" {
  * Routines provided by OS-dependent code
  ******************************************************************************/
 
-void os_init_graphics(void);
+void os_init_graphics(GfxContext *ctx);
 
-void os_clear_graphics(void);
+void os_clear_graphics(GfxContext *ctx);
 
-void os_set_colour(int colour, int index);
+void os_set_colour(GfxContext *ctx, int colour, int index);
 
-void os_draw_line(int x1, int y1, int x2, int y2, int colour1, int colour2);
+void os_draw_line(GfxContext *ctx, int x1, int y1, int x2, int y2, int colour1, int colour2);
 
-void os_fill(int x, int y, int colour1, int colour2);
+void os_fill(GfxContext *ctx, int x, int y, int colour1, int colour2);
 
 /*******************************************************************************
  * Routines provided by Level 9 graphics interpreter
  ******************************************************************************/
 
-bool load_graphics(char *filename, GfxTypes gfx_type);
+bool load_graphics(GfxFile *file, char *filename, GfxTypes gfx_type);
+
+void get_picture_size(const GfxFile *file, int *width, int *height);
+
+bool get_picture_data(const GfxFile *file, uint8_t **data, uint32_t *size);
 
-void get_picture_size(int *width, int *height);
+void init_graphics_context(GfxContext *ctx, const GfxFile *file, void *os_data);
 
-bool show_picture(int pic);
+bool show_picture(GfxContext *ctx, int pic);
 
-bool run_graphics(void);
+bool run_graphics(GfxContext *ctx);
 
-void free_memory(void);
+void free_memory(GfxFile *file);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Host replacement of the Z88DK arch/zxn.h header for building the Level 9
+ * interpreter on a host computer. Only the parts used by level9.c are provided.
+ * The MMU is emulated by host_memory_paging.c.
+ ******************************************************************************/
+
+#ifndef _HOST_ARCH_ZXN_H
+#define _HOST_ARCH_ZXN_H
+
+#include <stdint.h>
+
+#define HOST_PAGE_SIZE 0x2000
+
+// Number of 8 KB RAM pages in the emulated ZX Spectrum Next (2 MB model).
+#define HOST_NUM_PAGES 224
+
+extern uint8_t host_ram[HOST_NUM_PAGES * HOST_PAGE_SIZE];
+
+extern uint8_t host_mmu[8];
+
+#define HOST_SLOT_ADDRESS(slot) (host_ram + host_mmu[slot] * HOST_PAGE_SIZE)
+
+#define ZXN_WRITE_MMU0(page) (host_mmu[0] = (page))
+#define ZXN_WRITE_MMU1(page) (host_mmu[1] = (page))
+#define ZXN_WRITE_MMU2(page) (host_mmu[2] = (page))
+#define ZXN_WRITE_MMU3(page) (host_mmu[3] = (page))
+#define ZXN_WRITE_MMU4(page) (host_mmu[4] = (page))
+#define ZXN_WRITE_MMU5(page) (host_mmu[5] = (page))
+#define ZXN_WRITE_MMU6(page) (host_mmu[6] = (page))
+#define ZXN_WRITE_MMU7(page) (host_mmu[7] = (page))
+
+#define MMU2_ADDRESS HOST_SLOT_ADDRESS(2)
+
+#endif
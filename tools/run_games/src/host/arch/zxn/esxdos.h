@@ -0,0 +1,40 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Host replacement of the Z88DK arch/zxn/esxdos.h header for building the
+ * Level 9 interpreter on a host computer. The ESXDOS file functions are
+ * implemented on top of standard C file I/O by host_esxdos.c.
+ ******************************************************************************/
+
+#ifndef _HOST_ARCH_ZXN_ESXDOS_H
+#define _HOST_ARCH_ZXN_ESXDOS_H
+
+#include <stdint.h>
+
+#define ESX_MODE_R 0x01
+#define ESX_MODE_W 0x02
+#define ESX_MODE_OPEN_EXIST 0x00
+#define ESX_MODE_OPEN_CREAT 0x08
+#define ESX_MODE_OPEN_CREAT_TRUNC 0x0c
+
+#define ESX_SEEK_SET 0x00
+#define ESX_SEEK_FWD 0x01
+#define ESX_SEEK_BWD 0x02
+
+struct esx_stat
+{
+    uint8_t drive;
+    uint8_t device;
+    uint8_t attr;
+    uint32_t date;
+    uint32_t size;
+};
+
+extern uint8_t esx_f_open(char *filename, uint8_t mode);
+extern void esx_f_close(uint8_t handle);
+extern uint16_t esx_f_read(uint8_t handle, void *dst, uint16_t nbyte);
+extern uint16_t esx_f_write(uint8_t handle, void *src, uint16_t nbyte);
+extern uint32_t esx_f_seek(uint8_t handle, uint32_t dist, uint8_t whence);
+extern uint8_t esx_f_fstat(uint8_t handle, struct esx_stat *es);
+
+#endif
@@ -0,0 +1,24 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Compatibility definitions that are force-included in all host sources of the
+ * Level 9 interpreter. IDE_FRIENDLY disables the Z88DK C extensions.
+ ******************************************************************************/
+
+#ifndef _HOST_H
+#define _HOST_H
+
+#ifndef IDE_FRIENDLY
+#define IDE_FRIENDLY
+#endif
+
+#include <stdlib.h>
+#include <strings.h>
+
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+
+// Avoid a clash between the A-code random instruction and random() in stdlib.h.
+#define random l9_random
+
+#endif
@@ -0,0 +1,18 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Host replacement of the Z88DK stropts.h header. There are no terminal
+ * drivers on the host so all ioctl() calls are ignored.
+ ******************************************************************************/
+
+#ifndef _HOST_STROPTS_H
+#define _HOST_STROPTS_H
+
+#define IOCTL_OTERM_PAUSE 0x0501
+
+static inline int ioctl(int fd, int request, ...)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Host implementation of the ESXDOS file functions used by the Level 9
+ * interpreter. Like ESXDOS, errno is set to a non-zero value if an error occurs
+ * and is left untouched otherwise.
+ ******************************************************************************/
+
+#include <arch/zxn/esxdos.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define MAX_OPEN_FILES 8
+
+#define ESX_INVALID_FILE_HANDLE 0xFF
+
+static FILE *open_files[MAX_OPEN_FILES];
+
+static FILE *get_file(uint8_t handle)
+{
+    if ((handle >= MAX_OPEN_FILES) || (open_files[handle] == NULL))
+    {
+        errno = EBADF;
+        return NULL;
+    }
+
+    return open_files[handle];
+}
+
+uint8_t esx_f_open(char *filename, uint8_t mode)
+{
+    char *fmode;
+    int saved_errno = errno;
+
+    for (uint8_t handle = 0; handle < MAX_OPEN_FILES; handle++)
+    {
+        if (open_files[handle] == NULL)
+        {
+            if (mode & ESX_MODE_W)
+            {
+                fmode = ((mode & ESX_MODE_OPEN_CREAT_TRUNC) == ESX_MODE_OPEN_CREAT_TRUNC) ? "wb" : "r+b";
+            }
+            else
+            {
+                fmode = "rb";
+            }
+
+            open_files[handle] = fopen(filename, fmode);
+            if (open_files[handle] == NULL)
+            {
+                if (errno == 0)
+                {
+                    errno = ENOENT;
+                }
+                return ESX_INVALID_FILE_HANDLE;
+            }
+
+            // The C library may touch errno also when fopen() succeeds.
+            errno = saved_errno;
+            return handle;
+        }
+    }
+
+    errno = EMFILE;
+    return ESX_INVALID_FILE_HANDLE;
+}
+
+void esx_f_close(uint8_t handle)
+{
+    FILE *file = get_file(handle);
+
+    if (file != NULL)
+    {
+        fclose(file);
+        open_files[handle] = NULL;
+    }
+}
+
+uint16_t esx_f_read(uint8_t handle, void *dst, uint16_t nbyte)
+{
+    FILE *file = get_file(handle);
+    size_t num_read;
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    num_read = fread(dst, 1, nbyte, file);
+    if (ferror(file))
+    {
+        errno = EIO;
+    }
+    return (uint16_t) num_read;
+}
+
+uint16_t esx_f_write(uint8_t handle, void *src, uint16_t nbyte)
+{
+    FILE *file = get_file(handle);
+    size_t num_written;
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    num_written = fwrite(src, 1, nbyte, file);
+    if (num_written != nbyte)
+    {
+        errno = EIO;
+    }
+    return (uint16_t) num_written;
+}
+
+uint32_t esx_f_seek(uint8_t handle, uint32_t dist, uint8_t whence)
+{
+    FILE *file = get_file(handle);
+    int status;
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    switch (whence)
+    {
+        case ESX_SEEK_FWD:
+            status = fseek(file, (long) dist, SEEK_CUR);
+            break;
+        case ESX_SEEK_BWD:
+            status = fseek(file, -((long) dist), SEEK_CUR);
+            break;
+        case ESX_SEEK_SET:
+        default:
+            status = fseek(file, (long) dist, SEEK_SET);
+            break;
+    }
+
+    if (status != 0)
+    {
+        errno = EIO;
+    }
+    return (uint32_t) ftell(file);
+}
+
+uint8_t esx_f_fstat(uint8_t handle, struct esx_stat *es)
+{
+    FILE *file = get_file(handle);
+    long pos;
+
+    if (file == NULL)
+    {
+        return 1;
+    }
+
+    pos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    es->drive = 0;
+    es->device = 0;
+    es->attr = 0;
+    es->date = 0;
+    es->size = (uint32_t) ftell(file);
+    fseek(file, pos, SEEK_SET);
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Host implementation of the memory paging functions in memory_paging.asm. The
+ * RAM of the ZX Spectrum Next is emulated by a host array of 8 KB pages and the
+ * MMU slots by an array of page numbers.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <stdint.h>
+
+#include "memory_paging.h"
+
+uint8_t host_ram[HOST_NUM_PAGES * HOST_PAGE_SIZE];
+
+uint8_t host_mmu[8] = { 255, 255, 10, 11, 4, 5, 0, 1 };
+
+uint8_t current_page;
+
+// The first pages that init_page_allocator() allocates on the target with all
+// memory areas enabled (the page allocator is not part of the host build).
+uint8_t undo_base_page = 48;
+uint8_t picture_data_base_page = 52;
+uint8_t gfx_work_page = 60;
+uint8_t vocabulary_base_page = 61;
+
+static uint8_t *page_in(uint8_t new_page, uint16_t addr)
+{
+    if (current_page != new_page)
+    {
+        current_page = new_page;
+        ZXN_WRITE_MMU0(current_page);
+        ZXN_WRITE_MMU1(current_page + 1);
+    }
+
+    // The next page is contiguous with the current page in the host RAM.
+    return HOST_SLOT_ADDRESS(0) + addr;
+}
+
+void page_in_rom(void)
+{
+    ZXN_WRITE_MMU0(255);
+    ZXN_WRITE_MMU1(255);
+}
+
+void page_in_game(void)
+{
+    ZXN_WRITE_MMU0(current_page);
+    ZXN_WRITE_MMU1(current_page + 1);
+}
+
+uint8_t *effective(uint16_t ptr)
+{
+    return page_in(MEMORY_BASE_PAGE + (ptr / 0x2000), ptr % 0x2000);
+}
+
+uint8_t *effective_ram_save(uint8_t slot)
+{
+    // Same slot size as in memory_paging.asm, i.e. sizeof(save_struct_t).
+    uint16_t slot_addr = slot * 2560;
+    return page_in(RAM_SAVE_BASE_PAGE + (slot_addr / 0x2000), slot_addr % 0x2000);
+}
+
+uint8_t *effective_undo(uint16_t offset)
+{
+    return page_in(undo_base_page + 1 + (offset / 0x2000), offset % 0x2000);
+}
+
+uint8_t *effective_vocabulary(uint16_t offset)
+{
+    return page_in(vocabulary_base_page + (offset / 0x2000), offset % 0x2000);
+}
@@ -0,0 +1,741 @@
+/*******************************************************************************
+ * Stefan Bylund 2021
+ *
+ * Headless test runner for the Level 9 interpreter.
+ *
+ * The Level 9 interpreter (level9.c) is compiled for the host computer with
+ * this file providing the OS-dependent routines. Each game directory in the
+ * given games directory is expected to contain the game file(s), the game info
+ * file gamedata.txt and one or more walkthrough scripts named script*.txt, i.e.
+ * the same layout as the game directories in the Level 9 games compilation.
+ *
+ * Each game and script combination is run as a separate job. The jobs are run
+ * in parallel in a pool of worker processes, by default one per CPU core. A job
+ * plays back its script using the #play command and ends when the game asks for
+ * input after the script has been played back.
+ *
+ * Multiple choice games never ask for an input line, they poll for key presses
+ * instead. If the game keeps polling for a key press before it has asked for
+ * any input line, the script is instead played back as key presses, where the
+ * first character of each script line (after removing comments) is one key
+ * press. The job ends when all key presses have been played back.
+ *
+ * Prompts waiting for a key press, i.e. "(Y/N)" and "press" prompts, are
+ * answered with 'y' and space, respectively. If a text adventure game keeps
+ * polling for a key press at any other prompt, the job is ended as unsupported.
+ *
+ * The output of each job is written to a transcript file and a summary of all
+ * jobs is written as a CSV file with the following columns:
+ *
+ * game, script, status, wall_ms, opcodes, lines, score
+ *
+ * The status is one of ok (the whole script was played back), stopped (the
+ * game stopped before the end of the script), error (the game could not be
+ * loaded or a fatal error occurred), timeout (the job exceeded the maximum
+ * number of opcodes or its time limit), unsupported (the game waited for a key
+ * press that the runner cannot provide) and crash (the job was terminated by a
+ * signal). The score column contains the last line of output containing the
+ * word "score", if any.
+ ******************************************************************************/
+
+#include <arch/zxn.h>
+#include <arch/zxn/esxdos.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "level9.h"
+#include "memory_paging.h"
+
+#define SINGLE_GAME_FILE "gamedata.dat"
+#define MULTI_GAME_FILE "gamedat1.dat"
+
+#define NAME_SIZE 256
+
+#define SCORE_SIZE 128
+
+#define LINE_SIZE 512
+
+#define SAVE_BUFFER_SIZE 0x2000
+
+#define DEFAULT_MAX_OPCODES 500000000UL
+
+#define DEFAULT_TIME_LIMIT 300
+
+#define DEFAULT_TRANSCRIPT_DIR "transcripts"
+
+// Number of unanswered key polls before the script is played back as key
+// presses, i.e. before the game is considered to be a multiple choice game.
+#define KEY_MODE_POLLS 50
+
+// Number of unanswered key polls before the job is ended as unsupported.
+#define MAX_UNANSWERED_POLLS 100000
+
+// Exit codes of the worker processes.
+#define EXIT_OK 0
+#define EXIT_ERROR 1
+#define EXIT_TIMEOUT 2
+#define EXIT_STOPPED 3
+#define EXIT_UNSUPPORTED 4
+
+typedef struct job
+{
+    char game[NAME_SIZE];
+    char script[NAME_SIZE];
+    pid_t pid;
+    struct timespec start_time;
+    double wall_ms;
+    const char *status;
+
+    // Updated by the worker process in shared memory.
+    uint64_t num_opcodes;
+    uint32_t num_lines;
+    char score[SCORE_SIZE];
+} job_t;
+
+static job_t *jobs = NULL;
+
+static uint32_t num_jobs = 0;
+
+static char games_dir[PATH_MAX];
+
+static char transcript_dir[PATH_MAX] = DEFAULT_TRANSCRIPT_DIR;
+
+static uint64_t max_opcodes = DEFAULT_MAX_OPCODES;
+
+static uint32_t time_limit = DEFAULT_TIME_LIMIT;
+
+// State of the job being run by this worker process.
+
+static job_t *current_job;
+
+static uint8_t game_file[MAX_PATH];
+
+static uint8_t game_number = 1;
+
+static bool play_requested = false;
+
+static bool script_opened = false;
+
+static bool script_completed = false;
+
+static char line[LINE_SIZE];
+
+static uint16_t line_pos = 0;
+
+static bool prompt_answered = false;
+
+static FILE *key_script = NULL;
+
+static uint32_t unanswered_polls = 0;
+
+static uint8_t save_buffer[SAVE_BUFFER_SIZE];
+
+static uint16_t save_size = 0;
+
+/*******************************************************************************
+ * Routines provided by OS-dependent code
+ ******************************************************************************/
+
+void os_print_char(uint8_t c)
+{
+    if (c == '\r')
+    {
+        line[line_pos] = '\0';
+        if (strcasestr(line, "score") != NULL)
+        {
+            snprintf(current_job->score, SCORE_SIZE, "%.*s", SCORE_SIZE - 1, line);
+        }
+        current_job->num_lines++;
+        line_pos = 0;
+        putchar('\n');
+    }
+    else if (isprint(c))
+    {
+        prompt_answered = false;
+        if (line_pos < LINE_SIZE - 1)
+        {
+            line[line_pos++] = c;
+        }
+        putchar(c);
+    }
+}
+
+void os_flush(void)
+{
+    fflush(stdout);
+}
+
+bool os_input(uint8_t *in_buf, uint16_t size)
+{
+    unanswered_polls = 0;
+
+    // The first input starts the playback of the script.
+    if (!play_requested)
+    {
+        play_requested = true;
+        snprintf((char *) in_buf, size, "#play");
+        return true;
+    }
+
+    // The script has been played back (or could not be opened) so end the job.
+    script_completed = script_opened;
+    stop_game();
+    return false;
+}
+
+static uint8_t prompt_key(void)
+{
+    line[line_pos] = '\0';
+
+    if (strstr(line, "(Y/N)") != NULL)
+    {
+        return 'y';
+    }
+
+    if (strcasestr(line, "press") != NULL)
+    {
+        return ' ';
+    }
+
+    return 0;
+}
+
+static uint8_t next_script_key(void)
+{
+    char script_line[LINE_SIZE];
+
+    while (fgets(script_line, sizeof(script_line), key_script) != NULL)
+    {
+        char c = script_line[0];
+
+        if ((c != '\n') && (c != '\r') && (c != '[') && (c != ';') && (c != '\0'))
+        {
+            unanswered_polls = 0;
+            return (uint8_t) c;
+        }
+    }
+
+    // All key presses have been played back so end the job.
+    script_completed = true;
+    stop_game();
+    return 0;
+}
+
+uint8_t os_read_char(uint16_t millis)
+{
+    uint8_t key;
+
+    // Answer a recognised prompt once per printed prompt.
+    if (!prompt_answered && ((key = prompt_key()) != 0))
+    {
+        prompt_answered = true;
+        unanswered_polls = 0;
+        return key;
+    }
+
+    if (key_script != NULL)
+    {
+        return next_script_key();
+    }
+
+    // A game polling for key presses without ever asking for an input line is
+    // a multiple choice game, so play back the script as key presses.
+    if ((++unanswered_polls >= KEY_MODE_POLLS) && !play_requested)
+    {
+        key_script = fopen(current_job->script, "r");
+        script_opened = (key_script != NULL);
+        if (!script_opened)
+        {
+            stop_game();
+            return 0;
+        }
+        return next_script_key();
+    }
+
+    if (unanswered_polls >= MAX_UNANSWERED_POLLS)
+    {
+        free_memory();
+        exit(EXIT_UNSUPPORTED);
+    }
+
+    return 0;
+}
+
+bool os_save_file(uint8_t *ptr, uint16_t size)
+{
+    if (size > SAVE_BUFFER_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(save_buffer, ptr, size);
+    save_size = size;
+    return true;
+}
+
+bool os_load_file(uint8_t *ptr, uint16_t *size, uint16_t max_size)
+{
+    if ((save_size == 0) || (save_size > max_size))
+    {
+        return false;
+    }
+
+    memcpy(ptr, save_buffer, save_size);
+    *size = save_size;
+    return true;
+}
+
+bool os_get_game_file(uint8_t *new_name, uint16_t size)
+{
+    for (uint16_t i = strlen((char *) new_name) - 1; i > 0; i--)
+    {
+        if (isdigit(new_name[i]))
+        {
+            game_number++;
+            new_name[i] = '0' + game_number;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void os_set_file_number(uint8_t *new_name, uint16_t size, uint8_t num)
+{
+    for (uint16_t i = strlen((char *) new_name) - 1; i > 0; i--)
+    {
+        if (isdigit(new_name[i]))
+        {
+            new_name[i] = '0' + num;
+            return;
+        }
+    }
+}
+
+void os_graphics(bool graphics_on)
+{
+}
+
+void os_clear_graphics(void)
+{
+}
+
+void os_show_bitmap(uint16_t pic)
+{
+}
+
+uint8_t os_open_script_file(void)
+{
+    uint8_t fh;
+
+    page_in_rom();
+    errno = 0;
+    fh = esx_f_open(current_job->script, ESX_MODE_OPEN_EXIST | ESX_MODE_R);
+    script_opened = (errno == 0);
+    page_in_game();
+    return fh;
+}
+
+void os_fatal_error(uint8_t *format, ...)
+{
+    va_list args;
+
+    printf("\nFatal error: ");
+    va_start(args, format);
+    vprintf((char *) format, args);
+    va_end(args);
+    putchar('\n');
+
+    exit(EXIT_ERROR);
+}
+
+/*******************************************************************************
+ * Worker process
+ ******************************************************************************/
+
+static bool file_exists(const char *filename)
+{
+    struct stat filestat;
+    return (stat(filename, &filestat) == 0) && S_ISREG(filestat.st_mode);
+}
+
+static void run_job(job_t *job)
+{
+    char path[PATH_MAX + 2 * NAME_SIZE];
+    char *transcript;
+    FILE *fp;
+
+    current_job = job;
+
+    snprintf(path, sizeof(path), "%s/%s-%s", transcript_dir, job->game, job->script);
+    transcript = strdup(path);
+    snprintf(path, sizeof(path), "%s/%s", games_dir, job->game);
+
+    if ((transcript == NULL) || (chdir(path) != 0) || ((fp = fopen(transcript, "w")) == NULL))
+    {
+        exit(EXIT_ERROR);
+    }
+
+    fflush(stdout);
+    dup2(fileno(fp), STDOUT_FILENO);
+    fclose(fp);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (time_limit != 0)
+    {
+        alarm(time_limit);
+    }
+
+    if (file_exists(SINGLE_GAME_FILE))
+    {
+        strcpy((char *) game_file, SINGLE_GAME_FILE);
+    }
+    else if (file_exists(MULTI_GAME_FILE))
+    {
+        strcpy((char *) game_file, MULTI_GAME_FILE);
+    }
+    else
+    {
+        os_fatal_error((uint8_t *) "Unable to find game file.");
+    }
+
+    if (!load_game(game_file))
+    {
+        os_fatal_error((uint8_t *) "Unable to load game file.");
+    }
+
+    while (run_game())
+    {
+        if (++job->num_opcodes >= max_opcodes)
+        {
+            free_memory();
+            exit(EXIT_TIMEOUT);
+        }
+    }
+
+    free_memory();
+    exit(script_completed ? EXIT_OK : EXIT_STOPPED);
+}
+
+/*******************************************************************************
+ * Job scheduling
+ ******************************************************************************/
+
+static bool is_script_file(const char *filename)
+{
+    size_t len = strlen(filename);
+    return (len >= 10) && (strncasecmp(filename, "script", 6) == 0) &&
+        (strcasecmp(filename + len - 4, ".txt") == 0);
+}
+
+static int compare_jobs(const void *a, const void *b)
+{
+    const job_t *job_a = (const job_t *) a;
+    const job_t *job_b = (const job_t *) b;
+    int result = strcmp(job_a->game, job_b->game);
+    return (result != 0) ? result : strcmp(job_a->script, job_b->script);
+}
+
+static bool find_jobs(void)
+{
+    char path[PATH_MAX + NAME_SIZE];
+    struct dirent *game_entry;
+    struct dirent *script_entry;
+    DIR *game_dirs;
+    DIR *script_dirs;
+    job_t *job_list = NULL;
+    uint32_t max_jobs = 0;
+    struct stat filestat;
+
+    game_dirs = opendir(games_dir);
+    if (game_dirs == NULL)
+    {
+        fprintf(stderr, "Cannot open games directory %s.\n", games_dir);
+        return false;
+    }
+
+    while ((game_entry = readdir(game_dirs)) != NULL)
+    {
+        if ((game_entry->d_name[0] == '.') || (strlen(game_entry->d_name) >= NAME_SIZE))
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", games_dir, game_entry->d_name);
+        if ((stat(path, &filestat) != 0) || !S_ISDIR(filestat.st_mode))
+        {
+            continue;
+        }
+
+        script_dirs = opendir(path);
+        if (script_dirs == NULL)
+        {
+            continue;
+        }
+
+        while ((script_entry = readdir(script_dirs)) != NULL)
+        {
+            if (!is_script_file(script_entry->d_name) || (strlen(script_entry->d_name) >= NAME_SIZE))
+            {
+                continue;
+            }
+
+            if (num_jobs == max_jobs)
+            {
+                max_jobs = (max_jobs == 0) ? 64 : 2 * max_jobs;
+                job_list = realloc(job_list, max_jobs * sizeof(job_t));
+                if (job_list == NULL)
+                {
+                    fprintf(stderr, "Out of memory.\n");
+                    exit(1);
+                }
+            }
+
+            memset(&job_list[num_jobs], 0, sizeof(job_t));
+            strcpy(job_list[num_jobs].game, game_entry->d_name);
+            strcpy(job_list[num_jobs].script, script_entry->d_name);
+            num_jobs++;
+        }
+
+        closedir(script_dirs);
+    }
+
+    closedir(game_dirs);
+
+    if (num_jobs == 0)
+    {
+        fprintf(stderr, "No script*.txt files found in the game directories of %s.\n", games_dir);
+        return false;
+    }
+
+    qsort(job_list, num_jobs, sizeof(job_t), compare_jobs);
+
+    // The jobs are shared with the worker processes, which update their statistics.
+    jobs = mmap(NULL, num_jobs * sizeof(job_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (jobs == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot allocate shared memory.\n");
+        exit(1);
+    }
+
+    memcpy(jobs, job_list, num_jobs * sizeof(job_t));
+    free(job_list);
+    return true;
+}
+
+static double elapsed_ms(const struct timespec *start_time)
+{
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    return (end_time.tv_sec - start_time->tv_sec) * 1000.0 + (end_time.tv_nsec - start_time->tv_nsec) / 1000000.0;
+}
+
+static const char *job_status(int status)
+{
+    if (WIFEXITED(status))
+    {
+        switch (WEXITSTATUS(status))
+        {
+            case EXIT_OK: return "ok";
+            case EXIT_TIMEOUT: return "timeout";
+            case EXIT_STOPPED: return "stopped";
+            case EXIT_UNSUPPORTED: return "unsupported";
+            default: return "error";
+        }
+    }
+
+    return (WIFSIGNALED(status) && (WTERMSIG(status) == SIGALRM)) ? "timeout" : "crash";
+}
+
+static void run_jobs(uint32_t num_workers)
+{
+    uint32_t next_job = 0;
+    uint32_t num_running = 0;
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    while ((next_job < num_jobs) || (num_running > 0))
+    {
+        while ((next_job < num_jobs) && (num_running < num_workers))
+        {
+            job_t *job = &jobs[next_job++];
+
+            clock_gettime(CLOCK_MONOTONIC, &job->start_time);
+            pid = fork();
+            if (pid == 0)
+            {
+                run_job(job);
+            }
+            else if (pid < 0)
+            {
+                job->status = "error";
+                continue;
+            }
+
+            job->pid = pid;
+            num_running++;
+        }
+
+        pid = wait(&status);
+        if (pid < 0)
+        {
+            break;
+        }
+
+        for (uint32_t i = 0; i < num_jobs; i++)
+        {
+            if (jobs[i].pid == pid)
+            {
+                jobs[i].wall_ms = elapsed_ms(&jobs[i].start_time);
+                jobs[i].status = job_status(status);
+                fprintf(stderr, "%-11s %s/%s\n", jobs[i].status, jobs[i].game, jobs[i].script);
+                num_running--;
+                break;
+            }
+        }
+    }
+}
+
+static void write_csv_field(FILE *fp, const char *field)
+{
+    fputc('"', fp);
+    for (; *field != '\0'; field++)
+    {
+        if (*field == '"')
+        {
+            fputc('"', fp);
+        }
+        fputc(*field, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_csv(FILE *fp)
+{
+    fprintf(fp, "game,script,status,wall_ms,opcodes,lines,score\n");
+
+    for (uint32_t i = 0; i < num_jobs; i++)
+    {
+        job_t *job = &jobs[i];
+
+        write_csv_field(fp, job->game);
+        fputc(',', fp);
+        write_csv_field(fp, job->script);
+        fprintf(fp, ",%s,%.0f,%llu,%u,", job->status, job->wall_ms,
+            (unsigned long long) job->num_opcodes, job->num_lines);
+        write_csv_field(fp, job->score);
+        fputc('\n', fp);
+    }
+}
+
+static void print_usage(void)
+{
+    printf("Usage: run_games [-j <jobs>] [-m <max-opcodes>] [-t <seconds>] [-l <transcript-dir>] [-o <csv-file>] <games-dir>\n");
+    printf("Plays back the walkthrough scripts (script*.txt) of all games in the game\n");
+    printf("directories of the given games directory and writes a CSV summary.\n");
+    printf("Options:\n");
+    printf("-j <jobs>: Number of games to run in parallel (default is one per CPU core).\n");
+    printf("-m <max-opcodes>: Maximum number of opcodes to execute per script (default %lu).\n", DEFAULT_MAX_OPCODES);
+    printf("-t <seconds>: Time limit per script, 0 for no limit (default %u).\n", DEFAULT_TIME_LIMIT);
+    printf("-l <transcript-dir>: Directory for the transcripts (default %s).\n", DEFAULT_TRANSCRIPT_DIR);
+    printf("-o <csv-file>: CSV file to write (default is standard output).\n");
+}
+
+int main(int argc, char *argv[])
+{
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    char path[PATH_MAX];
+    char *csv_file = NULL;
+    FILE *fp = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:m:t:l:o:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j':
+                num_workers = atol(optarg);
+                break;
+            case 'm':
+                max_opcodes = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                time_limit = (uint32_t) atol(optarg);
+                break;
+            case 'l':
+                snprintf(transcript_dir, sizeof(transcript_dir), "%s", optarg);
+                break;
+            case 'o':
+                csv_file = optarg;
+                break;
+            default:
+                print_usage();
+                return 1;
+        }
+    }
+
+    if ((optind != argc - 1) || (num_workers < 1) || (max_opcodes == 0))
+    {
+        print_usage();
+        return 1;
+    }
+
+    // The worker processes change directory so make the directories absolute.
+    if (realpath(argv[optind], games_dir) == NULL)
+    {
+        fprintf(stderr, "Cannot find games directory %s.\n", argv[optind]);
+        return 1;
+    }
+
+    mkdir(transcript_dir, 0777);
+    if (realpath(transcript_dir, path) == NULL)
+    {
+        fprintf(stderr, "Cannot create transcript directory %s.\n", transcript_dir);
+        return 1;
+    }
+    strcpy(transcript_dir, path);
+
+    if (!find_jobs())
+    {
+        return 1;
+    }
+
+    if (csv_file != NULL)
+    {
+        fp = fopen(csv_file, "w");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Cannot create CSV file %s.\n", csv_file);
+            return 1;
+        }
+    }
+
+    run_jobs((uint32_t) num_workers);
+    write_csv(fp);
+
+    if (fp != stdout)
+    {
+        fclose(fp);
+    }
+
+    return 0;
+}